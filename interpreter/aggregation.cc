@@ -32,94 +32,171 @@ std::ostream& AggregateExpression::Dump(std::ostream& os) const {
   return os;
 }
 
-static double sum_af(const Query& filter,
-                     const TagsValuePairs& TagsValuePairs) {
-  auto total = kNAN;
-  for (const auto& m : TagsValuePairs) {
-    if (!std::isnan(m.value) && filter.Matches(m.tags)) {
-      if (std::isnan(total)) {
-        total = m.value;
-      } else {
-        total += m.value;
-      }
+static constexpr auto kInf = std::numeric_limits<double>::infinity();
+
+// The kernels below work on a contiguous column of values and keep
+// kLanes independent partial results without branches in the main loop,
+// which lets the compiler turn each step into a single vector operation.
+// NaN values are masked out using the fact that NaN != NaN.
+static constexpr size_t kLanes = 4;
+
+static size_t count_kernel(const double* vs, size_t n) noexcept {
+  size_t lanes[kLanes] = {0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (size_t j = 0; j < kLanes; ++j) {
+      lanes[j] += static_cast<size_t>(vs[i + j] == vs[i + j]);
     }
   }
-  return total;
+  auto count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  for (; i < n; ++i) {
+    count += static_cast<size_t>(vs[i] == vs[i]);
+  }
+  return count;
 }
 
-static double avg_af(const Query& filter,
-                     const TagsValuePairs& TagsValuePairs) {
-  auto total = kNAN;
-  auto count = 0;
-  for (const auto& m : TagsValuePairs) {
-    if (!std::isnan(m.value) && filter.Matches(m.tags)) {
-      ++count;
-      if (std::isnan(total)) {
-        total = m.value;
-      } else {
-        total += m.value;
-      }
+static double sum_kernel(const double* vs, size_t n) noexcept {
+  double lanes[kLanes] = {0.0, 0.0, 0.0, 0.0};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (size_t j = 0; j < kLanes; ++j) {
+      auto v = vs[i + j];
+      lanes[j] += v == v ? v : 0.0;
     }
   }
-  return count > 0 ? total / count : kNAN;
+  auto total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < n; ++i) {
+    auto v = vs[i];
+    total += v == v ? v : 0.0;
+  }
+  return total;
 }
 
-static double count_af(const Query& filter,
-                       const TagsValuePairs& TagsValuePairs) {
-  auto count = 0;
-  for (const auto& m : TagsValuePairs) {
-    if (!std::isnan(m.value) && filter.Matches(m.tags)) {
-      ++count;
+// comparisons against NaN are false, so NaN values never replace the
+// current min or max
+static double min_kernel(const double* vs, size_t n) noexcept {
+  double lanes[kLanes] = {kInf, kInf, kInf, kInf};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (size_t j = 0; j < kLanes; ++j) {
+      auto v = vs[i + j];
+      lanes[j] = v < lanes[j] ? v : lanes[j];
     }
   }
-  return count;
+  auto mn =
+      std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+  for (; i < n; ++i) {
+    auto v = vs[i];
+    mn = v < mn ? v : mn;
+  }
+  return mn;
 }
 
-static const double MAX_VALUE = std::numeric_limits<double>::max();
-static const double LOWEST_VALUE = std::numeric_limits<double>::lowest();
-
-static double min_af(const Query& filter, TagsValuePairs TagsValuePairs) {
-  auto mn = MAX_VALUE;
-  for (const auto& m : TagsValuePairs) {
-    if (!std::isnan(m.value) && filter.Matches(m.tags)) {
-      mn = std::min(mn, m.value);
+static double max_kernel(const double* vs, size_t n) noexcept {
+  double lanes[kLanes] = {-kInf, -kInf, -kInf, -kInf};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (size_t j = 0; j < kLanes; ++j) {
+      auto v = vs[i + j];
+      lanes[j] = v > lanes[j] ? v : lanes[j];
     }
   }
-  return mn == MAX_VALUE ? kNAN : mn;
+  auto mx =
+      std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+  for (; i < n; ++i) {
+    auto v = vs[i];
+    mx = v > mx ? v : mx;
+  }
+  return mx;
 }
 
-static double max_af(const Query& filter, TagsValuePairs TagsValuePairs) {
-  auto mx = LOWEST_VALUE;
-  for (const auto& m : TagsValuePairs) {
-    if (!std::isnan(m.value) && filter.Matches(m.tags)) {
-      mx = std::max(mx, m.value);
-    }
+double aggregation::Reduce(Aggregate aggregate, const double* values,
+                           size_t n) noexcept {
+  Accumulator accumulator{aggregate};
+  accumulator.AddColumn(values, n);
+  return accumulator.Result();
+}
+
+Accumulator::Accumulator(Aggregate aggregate) noexcept
+    : aggregate_(aggregate),
+      count_(0),
+      total_(0.0),
+      min_(kInf),
+      max_(-kInf) {}
+
+void Accumulator::Add(double value) noexcept {
+  if (std::isnan(value)) {
+    return;
   }
-  return mx == LOWEST_VALUE ? kNAN : mx;
+  ++count_;
+  total_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
 }
 
-TagsValuePair AggregateExpression::Apply(
-    const TagsValuePairs& tagsValuePairs) const {
-  double aggregate =
-      kNAN;  // quiets warning on gcc 4.8 about maybe uninitialized
+void Accumulator::AddColumn(const double* values, size_t n) noexcept {
+  auto count = count_kernel(values, n);
+  if (count == 0) {
+    return;
+  }
+  count_ += static_cast<int64_t>(count);
   switch (aggregate_) {
     case Aggregate::SUM:
-      aggregate = sum_af(*filter_, tagsValuePairs);
+    case Aggregate::AVG:
+      total_ += sum_kernel(values, n);
+      break;
+    case Aggregate::MIN:
+      min_ = std::min(min_, min_kernel(values, n));
+      break;
+    case Aggregate::MAX:
+      max_ = std::max(max_, max_kernel(values, n));
       break;
     case Aggregate::COUNT:
-      aggregate = count_af(*filter_, tagsValuePairs);
       break;
+  }
+}
+
+double Accumulator::Result() const noexcept {
+  if (aggregate_ == Aggregate::COUNT) {
+    return count_;
+  }
+  if (count_ == 0) {
+    return kNAN;
+  }
+  switch (aggregate_) {
+    case Aggregate::SUM:
+      return total_;
     case Aggregate::AVG:
-      aggregate = avg_af(*filter_, tagsValuePairs);
-      break;
+      return total_ / count_;
     case Aggregate::MIN:
-      aggregate = min_af(*filter_, tagsValuePairs);
-      break;
+      return min_;
     case Aggregate::MAX:
-      aggregate = max_af(*filter_, tagsValuePairs);
+      return max_;
+    case Aggregate::COUNT:
       break;
   }
-  return TagsValuePair{filter_->Tags(), aggregate};
+  return static_cast<double>(count_);
+}
+
+TagsValuePair AggregateExpression::Apply(
+    const TagsValuePairs& tagsValuePairs) const {
+  // select the values that match our filter into a column on the stack, and
+  // reduce it each time it fills up, so nothing is allocated
+  static constexpr size_t kChunkSize = 256;
+  double column[kChunkSize];
+  size_t n = 0;
+  Accumulator accumulator{aggregate_};
+  for (const auto& m : tagsValuePairs) {
+    if (filter_->Matches(m.tags)) {
+      column[n++] = m.value;
+      if (n == kChunkSize) {
+        accumulator.AddColumn(column, n);
+        n = 0;
+      }
+    }
+  }
+  accumulator.AddColumn(column, n);
+  return TagsValuePair{filter_->Tags(), accumulator.Result()};
 }
 
 // utility functions
@@ -8,6 +8,28 @@ namespace interpreter {
 
 enum class Aggregate { COUNT, SUM, MAX, MIN, AVG };
 
+/// Running state for an aggregate function, so values can be added one at a
+/// time instead of being collected first
+class Accumulator {
+ public:
+  explicit Accumulator(Aggregate aggregate) noexcept;
+
+  /// add a value. NaN values are ignored
+  void Add(double value) noexcept;
+
+  /// add a contiguous column of values, using vectorized kernels
+  void AddColumn(const double* values, size_t n) noexcept;
+
+  double Result() const noexcept;
+
+ private:
+  Aggregate aggregate_;
+  int64_t count_;
+  double total_;
+  double min_;
+  double max_;
+};
+
 class AggregateExpression : public ValueExpression {
  public:
   AggregateExpression(Aggregate aggregate, std::shared_ptr<Query> filter);
@@ -19,6 +41,12 @@ class AggregateExpression : public ValueExpression {
 
   std::shared_ptr<Query> GetQuery() const noexcept override { return filter_; }
 
+  bool IsAggregate() const noexcept override { return true; }
+
+  Aggregate GetAggregate() const noexcept { return aggregate_; }
+
+  const Query& Filter() const noexcept { return *filter_; }
+
  private:
   Aggregate aggregate_;
   std::shared_ptr<Query> filter_;
@@ -26,6 +54,10 @@ class AggregateExpression : public ValueExpression {
 
 namespace aggregation {
 
+/// Reduce a contiguous column of values using the given aggregate function.
+/// NaN values are ignored
+double Reduce(Aggregate aggregate, const double* values, size_t n) noexcept;
+
 std::unique_ptr<AggregateExpression> count(std::shared_ptr<Query> filter);
 
 std::unique_ptr<AggregateExpression> sum(std::shared_ptr<Query> filter);
@@ -39,6 +39,14 @@ std::string Context::PopString() {
   return std::static_pointer_cast<Literal>(maybe_str)->AsString();
 }
 
+util::StrRef Context::PopRef() {
+  ensure_stack_notempty(*stack_);
+  auto maybe_str = PopExpression();
+  ensure(expression::IsLiteral(*maybe_str),
+         "Wrong type. Expecting a literal string.");
+  return static_cast<const Literal&>(*maybe_str).AsRef();
+}
+
 void Context::PushToList(std::shared_ptr<Expression> expression) {
   ensure_stack_notempty(*stack_);
   auto top = TopOfStack().get();
@@ -16,6 +16,9 @@ class Context {
 
   std::string PopString();
 
+  /// pop a literal as an interned string, without copying it
+  util::StrRef PopRef();
+
   std::shared_ptr<Expression> PopExpression();
 
   void Push(std::shared_ptr<Expression> expression);
@@ -1,33 +1,53 @@
 #include "expression.h"
 #include "../util/logger.h"
 #include "query.h"
+#include <cstring>
 
 namespace atlas {
 namespace interpreter {
 
 using meter::Measurements;
 using util::Logger;
-using util::intern_str;
 
-Literal::Literal(std::string str) noexcept : str_(std::move(str)) {}
+void AcquireRefs(StringRefs* refs) noexcept {
+  for (auto& ref : *refs) {
+    ref = util::acquire_ref(ref);
+  }
+}
+
+void ReleaseRefs(const StringRefs& refs) noexcept {
+  for (auto ref : refs) {
+    util::release_ref(ref);
+  }
+}
 
-bool Literal::Is(const std::string& str) const noexcept { return str_ == str; }
+Literal::Literal(const std::string& str) noexcept
+    : str_(util::acquire_str(str)) {}
+
+Literal::Literal(util::StrRef str) noexcept : str_(util::acquire_ref(str)) {}
+
+Literal::Literal(const char* data, size_t size) noexcept
+    : str_(util::acquire_str(data, size)) {}
+
+bool Literal::Is(const std::string& str) const noexcept {
+  return std::strcmp(str_.get(), str.c_str()) == 0;
+}
 
 std::ostream& Literal::Dump(std::ostream& os) const {
-  os << "Literal(" << str_ << ")";
+  os << "Literal(" << str_.get() << ")";
   return os;
 }
 
-bool Literal::IsWord() const noexcept { return str_[0] == ':'; }
+bool Literal::IsWord() const noexcept { return str_.get()[0] == ':'; }
 
 const std::string Literal::GetWord() const {
   if (!this->IsWord()) {
     Logger()->error("Internal error: GetWord() called on non-word: ", *this);
   }
-  return str_.substr(1);
+  return std::string(str_.get() + 1);
 }
 
-std::string Literal::AsString() const noexcept { return str_; }
+std::string Literal::AsString() const noexcept { return str_.get(); }
 
 std::ostream& ConstantExpression::Dump(std::ostream& os) const {
   os << "ConstantExpression(" << value_ << ")";
@@ -71,7 +91,7 @@ std::unique_ptr<StringRefs> List::ToStrings() const {
   strs->reserve(list_.size());
   for (auto& e : list_) {
     if (expression::IsLiteral(*e)) {
-      strs->push_back(intern_str(expression::LiteralToStr(*e)));
+      strs->push_back(static_cast<const Literal&>(*e).AsRef());
     }
   }
   return strs;
@@ -99,11 +119,10 @@ std::ostream& operator<<(std::ostream& os, const TagsValuePair& tagsValuePair) {
   return os;
 }
 
-const auto kNameRef = intern_str("name");
+const auto kNameRef = util::intern_str("name");
 TagsValuePair TagsValuePair::from(const meter::Measurement& measurement,
                                   const meter::Tags& common_tags) noexcept {
-  meter::Tags tags{common_tags};
-  tags.add_all(measurement.id->GetTags());
+  auto tags = meter::Tags::Merge(common_tags, measurement.id->GetTags());
   tags.add(kNameRef, measurement.id->NameRef());
 
   return TagsValuePair{tags, measurement.value};
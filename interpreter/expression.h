@@ -10,6 +10,12 @@ namespace interpreter {
 
 using StringRefs = std::vector<util::StrRef>;
 
+/// take a reference to each string, for expressions that keep them
+void AcquireRefs(StringRefs* refs) noexcept;
+
+/// give back the references taken with AcquireRefs
+void ReleaseRefs(const StringRefs& refs) noexcept;
+
 enum class ExpressionType {
   Literal,
   List,
@@ -29,12 +35,27 @@ class Expression {
 
 std::ostream& operator<<(std::ostream& os, const Expression& expression);
 
+/// A token of a program. Literals hold a reference to their string, so the
+/// strings of expressions that are no longer used can be reclaimed
 class Literal : public Expression {
  public:
-  explicit Literal(std::string str) noexcept;
+  explicit Literal(const std::string& str) noexcept;
+
+  explicit Literal(util::StrRef str) noexcept;
+
+  /// a literal for a slice of a larger string
+  Literal(const char* data, size_t size) noexcept;
+
+  Literal(const Literal& other) noexcept : Literal(other.str_) {}
+
+  Literal& operator=(const Literal&) = delete;
+
+  ~Literal() override { util::release_ref(str_); }
 
   std::string AsString() const noexcept;
 
+  util::StrRef AsRef() const noexcept { return str_; }
+
   bool Is(const std::string& str) const noexcept;
 
   bool IsWord() const noexcept;
@@ -48,7 +69,7 @@ class Literal : public Expression {
   }
 
  private:
-  const std::string str_;
+  const util::StrRef str_;
 };
 
 class List : public Expression {
@@ -82,6 +103,8 @@ class ValueExpression : public Expression {
 
   virtual std::shared_ptr<Query> GetQuery() const noexcept = 0;
 
+  virtual bool IsAggregate() const noexcept { return false; }
+
   ExpressionType GetType() const noexcept override {
     return ExpressionType::ValueExpression;
   }
@@ -117,7 +140,7 @@ inline bool IsQuery(const Expression& e) noexcept {
 }
 
 inline bool Is(const Expression& e, const std::string& s) noexcept {
-  return IsLiteral(e) && static_cast<const Literal&>(e).AsString() == s;
+  return IsLiteral(e) && static_cast<const Literal&>(e).Is(s);
 }
 
 inline bool IsWord(const Expression& e) noexcept {
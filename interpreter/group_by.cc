@@ -1,11 +1,11 @@
 #include "group_by.h"
 #include "../util/logger.h"
+#include "hash_aggregation.h"
 
 namespace atlas {
 namespace interpreter {
 
 using util::Logger;
-using util::intern_str;
 
 namespace expression {
 
@@ -29,7 +29,9 @@ std::shared_ptr<MultipleResults> GetMultipleResults(
 using ::atlas::meter::Measurements;
 
 GroupBy::GroupBy(const List& keys, std::shared_ptr<ValueExpression> expr)
-    : keys_(keys.ToStrings()), expr_(std::move(expr)) {}
+    : keys_(keys.ToStrings()), expr_(std::move(expr)) {
+  AcquireRefs(keys_.get());
+}
 
 std::ostream& GroupBy::Dump(std::ostream& os) const {
   os << "GroupBy(" << keys_str(*keys_) << "," << *expr_ << ")";
@@ -37,36 +39,15 @@ std::ostream& GroupBy::Dump(std::ostream& os) const {
 }
 
 TagsValuePairs GroupBy::Apply(const TagsValuePairs& tagsValuePairs) {
-  // group metrics by keys
-  std::unordered_map<meter::Tags, TagsValuePairs> grouped;
-  for (auto& tagsValuePair : tagsValuePairs) {
-    auto should_keep = true;
-    meter::Tags group_by_vals;
-    for (auto& key : *keys_) {
-      auto value = get_value(tagsValuePair, key);
-      if (value) {
-        group_by_vals.add(key, intern_str(value.get()));
-      } else {
-        should_keep = false;
-        break;
-      }
-    }
-    if (should_keep) {
-      grouped[group_by_vals].push_back(tagsValuePair);
+  HashAggregation aggregation{*expr_};
+  GroupKey key;
+  key.reserve(keys_->size());
+  for (const auto& tagsValuePair : tagsValuePairs) {
+    if (GetGroupKey(tagsValuePair.tags, *keys_, &key)) {
+      aggregation.Add(key, tagsValuePair);
     }
   }
-
-  TagsValuePairs results;
-  for (auto& entry : grouped) {
-    auto tags = entry.first;
-    const auto& pairs_for_key = entry.second;
-    const auto& expr_results = expr_->Apply(pairs_for_key);
-    tags.add_all(expr_results.tags);
-
-    results.push_back(TagsValuePair{tags, expr_results.value});
-  }
-
-  return results;
+  return aggregation.Results(true);
 }
 }  // namespace interpreter
 }  // namespace atlas
@@ -11,6 +11,8 @@ class GroupBy : public MultipleResults {
  public:
   GroupBy(const List& keys, std::shared_ptr<ValueExpression> expr);
 
+  ~GroupBy() override { ReleaseRefs(*keys_); }
+
   ExpressionType GetType() const noexcept override {
     return ExpressionType::MultipleResults;
   }
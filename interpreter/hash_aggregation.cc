@@ -0,0 +1,87 @@
+#include "hash_aggregation.h"
+#include "../util/xxhash.h"
+
+namespace atlas {
+namespace interpreter {
+
+size_t GroupKeyHasher::operator()(const GroupKey& key) const noexcept {
+  // the refs are laid out next to each other, in the same order for a given
+  // grouping
+  return XXH64(key.data(), key.size() * sizeof(GroupKey::value_type), 0);
+}
+
+HashAggregation::HashAggregation(const ValueExpression& expr)
+    : expr_(expr),
+      aggregate_(expr.IsAggregate()
+                     ? static_cast<const AggregateExpression*>(&expr)
+                     : nullptr) {}
+
+void HashAggregation::Add(const GroupKey& key, const TagsValuePair& pair) {
+  auto it = groups_.find(key);
+  size_t idx;
+  if (it == groups_.end()) {
+    idx = groups_.size();
+    groups_.emplace(key, idx);
+    if (aggregate_ != nullptr) {
+      accumulators_.emplace_back(aggregate_->GetAggregate());
+    } else {
+      pairs_.emplace_back();
+    }
+  } else {
+    idx = it->second;
+  }
+
+  if (aggregate_ != nullptr) {
+    if (aggregate_->Filter().Matches(pair.tags)) {
+      accumulators_[idx].Add(pair.value);
+    }
+  } else {
+    pairs_[idx].push_back(pair);
+  }
+}
+
+TagsValuePairs HashAggregation::Results(bool add_expression_tags) const {
+  TagsValuePairs results;
+  results.reserve(groups_.size());
+  meter::Tags expression_tags;
+  if (add_expression_tags && aggregate_ != nullptr) {
+    expression_tags = aggregate_->Filter().Tags();
+  }
+
+  for (const auto& group : groups_) {
+    meter::Tags tags;
+    for (const auto& kv : group.first) {
+      tags.add(kv.first, kv.second);
+    }
+
+    double value;
+    if (aggregate_ != nullptr) {
+      value = accumulators_[group.second].Result();
+      tags.add_all(expression_tags);
+    } else {
+      const auto& expr_results = expr_.Apply(pairs_[group.second]);
+      value = expr_results.value;
+      if (add_expression_tags) {
+        tags.add_all(expr_results.tags);
+      }
+    }
+    results.push_back(TagsValuePair{tags, value});
+  }
+  return results;
+}
+
+bool GetGroupKey(const meter::Tags& tags, const StringRefs& keys,
+                 GroupKey* key) {
+  key->clear();
+  for (const auto& k : keys) {
+    auto it = tags.find(k);
+    if (it == tags.end()) {
+      return false;
+    }
+    key->emplace_back(k, it->second);
+  }
+  return true;
+}
+
+}  // namespace interpreter
+}  // namespace atlas
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "aggregation.h"
+#include <unordered_map>
+
+namespace atlas {
+namespace interpreter {
+
+/// (key, value) refs identifying a group. Keys are always in the same order
+/// for a given grouping so keys can be compared element by element. The refs
+/// are not counted: they come from the tags of the pairs being aggregated,
+/// so a HashAggregation must not outlive its input.
+using GroupKey = std::vector<std::pair<util::StrRef, util::StrRef>>;
+
+struct GroupKeyHasher {
+  size_t operator()(const GroupKey& key) const noexcept;
+};
+
+/// Hash aggregation used by :by, :keep-tags, and :drop-tags. Values are
+/// streamed into a per-group accumulator, so input pairs are never copied
+/// unless the value expression is not an aggregate.
+class HashAggregation {
+ public:
+  explicit HashAggregation(const ValueExpression& expr);
+
+  /// add the value of pair to the group identified by key. Only new groups
+  /// copy the key, so callers should reuse the same key across calls
+  void Add(const GroupKey& key, const TagsValuePair& pair);
+
+  /// one result per group. If add_expression_tags is true the tags
+  /// generated by the value expression are added to the group tags
+  TagsValuePairs Results(bool add_expression_tags) const;
+
+ private:
+  const ValueExpression& expr_;
+  // nullptr if expr_ is not an aggregate expression
+  const AggregateExpression* aggregate_;
+  std::unordered_map<GroupKey, size_t, GroupKeyHasher> groups_;
+  std::vector<Accumulator> accumulators_;
+  // only used when we can't stream values into an accumulator
+  std::vector<TagsValuePairs> pairs_;
+};
+
+/// Fill key with the values for keys found in tags. Returns false if any of
+/// the keys is missing
+bool GetGroupKey(const meter::Tags& tags, const StringRefs& keys,
+                 GroupKey* key);
+
+}  // namespace interpreter
+}  // namespace atlas
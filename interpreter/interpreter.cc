@@ -1,4 +1,5 @@
 #include "interpreter.h"
+#include "../util/intern.h"
 #include "../util/logger.h"
 #include "../util/optional.h"
 #include "group_by.h"
@@ -10,7 +11,7 @@ namespace interpreter {
 
 inline void add_nonempty(const std::string::size_type i,
                          const std::string::size_type j, const std::string& s,
-                         Expressions* result) {
+                         Tokens* result) {
   // j starts pointing at the comma
   std::string::size_type k = j - 1;
   // trim right
@@ -22,12 +23,11 @@ inline void add_nonempty(const std::string::size_type i,
 
   // only non-empty tokens
   if (k > i) {
-    result->push_back(std::make_unique<Literal>(s.substr(i, k - i)));
+    result->push_back(Token{s.data() + i, k - i});
   }
 }
 
-// split on ; and trim the elements. Does not add empty elements to the result
-void split(const std::string& s, Expressions* result) {
+void tokenize(const std::string& s, Tokens* result) {
   std::string::size_type i = 0;
 
   // trim left
@@ -48,15 +48,33 @@ void split(const std::string& s, Expressions* result) {
   add_nonempty(i, s.length(), s, result);
 }
 
+// split on , and trim the elements. Does not add empty elements to the result
+void split(const std::string& s, Expressions* result) {
+  Tokens tokens;
+  tokenize(s, &tokens);
+  result->reserve(result->size() + tokens.size());
+  for (const auto& token : tokens) {
+    result->push_back(std::make_unique<Literal>(token.data, token.size));
+  }
+}
+
 Interpreter::Interpreter(std::unique_ptr<Vocabulary> vocabulary)
     : vocabulary_(std::move(vocabulary)) {}
 
 const static std::string UNBALANCED = "Unbalanced parenthesis";
 const static OptionalString kNone{nullptr};
 
+static inline bool is_char(const Token& token, char c) {
+  return token.size == 1 && token.data[0] == c;
+}
+
+static std::shared_ptr<Expression> literal(const Token& token) {
+  return std::make_shared<Literal>(token.data, token.size);
+}
+
 static OptionalString do_program(Context* context, const Vocabulary& vocabulary,
-                                 Expressions* tokens, int depth) {
-  if (tokens->empty()) {
+                                 const Tokens& tokens, int depth) {
+  if (tokens.empty()) {
     if (depth == 0) {
       return kNone;
     }
@@ -64,33 +82,28 @@ static OptionalString do_program(Context* context, const Vocabulary& vocabulary,
   }
 
   int list_depth = depth;
-  for (auto& token : *tokens) {
-    if (expression::Is(*token, "(")) {
+  for (const auto& token : tokens) {
+    if (is_char(token, '(')) {
       ++list_depth;
       if (list_depth == 1) {
-        context->Push(std::make_unique<List>());
+        context->Push(std::make_shared<List>());
       } else {
-        context->PushToList(std::move(token));
+        context->PushToList(literal(token));
       }
-    } else if (expression::Is(*token, ")")) {
+    } else if (is_char(token, ')')) {
       --list_depth;
       if (list_depth > 0) {
-        context->PushToList(std::move(token));
+        context->PushToList(literal(token));
       } else if (list_depth < 0) {
         return OptionalString{UNBALANCED};
       }
-    } else if (expression::IsWord(*token)) {
-      const std::string& word = expression::GetWord(*token);
-      if (list_depth == 0) {
-        vocabulary.Execute(context, word);
-      } else {
-        context->PushToList(std::move(token));
-      }
+    } else if (token.data[0] == ':' && list_depth == 0) {
+      vocabulary.Execute(context, token.data + 1, token.size - 1);
     } else {
       if (list_depth == 0) {
-        context->Push(std::move(token));
+        context->Push(literal(token));
       } else {
-        context->PushToList(std::move(token));
+        context->PushToList(literal(token));
       }
     }
   }
@@ -98,9 +111,9 @@ static OptionalString do_program(Context* context, const Vocabulary& vocabulary,
 }
 
 void Interpreter::Execute(Context* context, const std::string& program) const {
-  Expressions tokens;
-  split(program, &tokens);
-  do_program(context, *vocabulary_, &tokens, 0);
+  Tokens tokens;
+  tokenize(program, &tokens);
+  do_program(context, *vocabulary_, tokens, 0);
 }
 
 std::shared_ptr<Query> Interpreter::GetQuery(const std::string& program) const {
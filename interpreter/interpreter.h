@@ -22,5 +22,17 @@ using Expressions = std::vector<std::unique_ptr<Expression>>;
 
 void split(const std::string& s, Expressions* result);
 
+/// A token is a slice of the program it was read from
+struct Token {
+  const char* data;
+  size_t size;
+};
+
+using Tokens = std::vector<Token>;
+
+/// split on , and trim the elements without copying them. Does not add empty
+/// elements to the result
+void tokenize(const std::string& s, Tokens* result);
+
 }  // namespace interpreter
 }  // namespace atlas
@@ -2,9 +2,8 @@
 #include "../meter/id.h"
 #include "../meter/measurement.h"
 #include "../util/dump.h"
+#include "hash_aggregation.h"
 #include <algorithm>
-#include <unordered_set>
-#include <iostream>
 
 namespace atlas {
 namespace interpreter {
@@ -18,60 +17,53 @@ const static auto kNameRef = intern_str("name");
 KeepOrDropTags::KeepOrDropTags(const List& keys,
                                std::shared_ptr<ValueExpression> expr, bool keep)
     : keys_(keys.ToStrings()), expr_(std::move(expr)), keep_(keep) {
+  AcquireRefs(keys_.get());
   if (keep) {
     // make sure we keep name, it's required
     if (std::find(keys_->begin(), keys_->end(), kNameRef) == keys_->end()) {
-      keys_->push_back(kNameRef);
+      keys_->push_back(util::acquire_ref(kNameRef));
     }
+  } else {
+    drop_set_.insert(keys_->begin(), keys_->end());
   }
 }
 
-using StringRefs = std::vector<StrRef>;
-static StringRefs drop_keys(const meter::Tags& tags, const StringRefs& keys) {
-  std::unordered_set<StrRef> keys_set(keys.begin(), keys.end());
-  StringRefs res{kNameRef};
-
-  // add all tag keys that are not in the set of keys to be dropped
+// name is always kept, plus all tags that are not in the set of keys to be
+// dropped. Tags are sorted by key so equal groups get equal keys regardless
+// of the iteration order of the tags
+static bool drop_key(const meter::Tags& tags,
+                     const std::unordered_set<StrRef>& drop_set,
+                     GroupKey* key) {
+  key->clear();
+  auto name = tags.find(kNameRef);
+  if (name == tags.end()) {
+    return false;
+  }
+  key->emplace_back(kNameRef, name->second);
   for (const auto& tag : tags) {
-    if (keys_set.find(tag.first) == end(keys_set)) {
-      res.push_back(tag.first);
+    auto dropped = drop_set.find(tag.first) != drop_set.end();
+    if (!dropped && !(tag.first == kNameRef)) {
+      key->emplace_back(tag.first, tag.second);
     }
   }
-  return res;
+  std::sort(key->begin() + 1, key->end(),
+            [](const GroupKey::value_type& a, const GroupKey::value_type& b) {
+              return a.first.get() < b.first.get();
+            });
+  return true;
 }
 
 TagsValuePairs KeepOrDropTags::Apply(const TagsValuePairs& valuePairs) {
-  // group metrics by keys
-  std::unordered_map<meter::Tags, TagsValuePairs> grouped;
-  for (auto& valuePair : valuePairs) {
-    auto should_keep = true;
-    meter::Tags group_by_vals;
-
-    const auto& keys = keep_ ? *keys_ : drop_keys(valuePair.tags, *keys_);
-
-    for (auto& key : keys) {
-      auto value = get_value(valuePair, key);
-      if (value) {
-        group_by_vals.add(key, intern_str(value.get()));
-      } else {
-        should_keep = false;
-        break;
-      }
-    }
+  HashAggregation aggregation{*expr_};
+  GroupKey key;
+  for (const auto& valuePair : valuePairs) {
+    auto should_keep = keep_ ? GetGroupKey(valuePair.tags, *keys_, &key)
+                             : drop_key(valuePair.tags, drop_set_, &key);
     if (should_keep) {
-      grouped[group_by_vals].push_back(valuePair);
+      aggregation.Add(key, valuePair);
     }
   }
-
-  TagsValuePairs results;
-  for (auto& entry : grouped) {
-    auto tags = entry.first;
-    const auto& measurements_for_tags = entry.second;
-    const auto& expr_results = expr_->Apply(measurements_for_tags);
-    results.push_back(TagsValuePair{tags, expr_results.value});
-  }
-
-  return results;
+  return aggregation.Results(false);
 }
 
 static const char* kKeep = "Keep";
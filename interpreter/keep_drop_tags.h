@@ -1,6 +1,7 @@
 #pragma once
 
 #include "multiple_results.h"
+#include <unordered_set>
 
 namespace atlas {
 namespace interpreter {
@@ -9,6 +10,8 @@ class KeepOrDropTags : public MultipleResults {
   KeepOrDropTags(const List& keys, std::shared_ptr<ValueExpression> expr,
                  bool keep);
 
+  ~KeepOrDropTags() override { ReleaseRefs(*keys_); }
+
   ExpressionType GetType() const noexcept override {
     return ExpressionType::MultipleResults;
   }
@@ -23,6 +26,7 @@ class KeepOrDropTags : public MultipleResults {
 
  private:
   std::unique_ptr<StringRefs> keys_;
+  std::unordered_set<util::StrRef> drop_set_;
   std::shared_ptr<ValueExpression> expr_;
   bool keep_;
 };
@@ -1,13 +1,13 @@
 #include "query.h"
 #include "../util/logger.h"
 #include "../meter/id.h"
+#include <cstring>
 
 namespace atlas {
 namespace interpreter {
 
 using util::Logger;
 using util::StrRef;
-using util::intern_str;
 
 const OptionalString kNone{nullptr};
 
@@ -19,6 +19,8 @@ bool Query::IsRegex() const noexcept { return false; }
 
 HasKeyQuery::HasKeyQuery(std::string key) : AbstractKeyQuery(std::move(key)) {}
 
+HasKeyQuery::HasKeyQuery(StrRef key) : AbstractKeyQuery(key) {}
+
 bool HasKeyQuery::Matches(const meter::Tags& tags) const {
   return tags.find(KeyRef()) != tags.end();
 }
@@ -29,7 +31,10 @@ std::ostream& HasKeyQuery::Dump(std::ostream& os) const {
 }
 
 AbstractKeyQuery::AbstractKeyQuery(std::string key) noexcept
-    : key_(std::move(key)) {}
+    : key_(std::move(key)), key_ref_(util::acquire_str(key_)) {}
+
+AbstractKeyQuery::AbstractKeyQuery(StrRef key) noexcept
+    : key_(key.get()), key_ref_(util::acquire_ref(key)) {}
 
 const OptionalString AbstractKeyQuery::getvalue(const meter::Tags& tags) const
     noexcept {
@@ -40,35 +45,51 @@ const OptionalString AbstractKeyQuery::getvalue(const meter::Tags& tags) const
   return OptionalString{k->second.get()};
 }
 
+StrRef AbstractKeyQuery::getref(const meter::Tags& tags) const noexcept {
+  auto k = tags.find(KeyRef());
+  if (k == tags.end()) {
+    return StrRef();
+  }
+  return k->second;
+}
+
 const std::string& AbstractKeyQuery::Key() const noexcept { return key_; }
 
-StrRef AbstractKeyQuery::KeyRef() const noexcept { return intern_str(key_); }
+StrRef AbstractKeyQuery::KeyRef() const noexcept { return key_ref_; }
 
 RelopQuery::RelopQuery(std::string k, std::string v, RelOp op)
-    : AbstractKeyQuery(std::move(k)), op_(op), value_(std::move(v)) {}
+    : AbstractKeyQuery(std::move(k)),
+      op_(op),
+      value_(std::move(v)),
+      value_ref_(util::acquire_str(value_)) {}
+
+RelopQuery::RelopQuery(StrRef k, StrRef v, RelOp op)
+    : AbstractKeyQuery(k),
+      op_(op),
+      value_(v.get()),
+      value_ref_(util::acquire_ref(v)) {}
 
 bool RelopQuery::Matches(const meter::Tags& tags) const {
-  auto current_value = getvalue(tags);
-  return do_query(current_value, value_, op_);
+  return do_query(getref(tags), value_ref_, op_);
 }
 
-bool RelopQuery::do_query(const OptionalString& cur_value, const std::string& v,
-                          RelOp op) {
-  if (!cur_value) {
+bool RelopQuery::do_query(StrRef cur_value, StrRef v, RelOp op) {
+  if (cur_value.get() == nullptr) {
     return false;
   }
 
+  // all tag values are interned, so equality never needs to look at the bytes
   switch (op) {
     case RelOp::EQ:
       return cur_value == v;
     case RelOp::LE:
-      return cur_value <= v;
+      return std::strcmp(cur_value.get(), v.get()) <= 0;
     case RelOp::LT:
-      return cur_value < v;
+      return std::strcmp(cur_value.get(), v.get()) < 0;
     case RelOp::GE:
-      return cur_value >= v;
+      return std::strcmp(cur_value.get(), v.get()) >= 0;
     case RelOp::GT:
-      return cur_value > v;
+      return std::strcmp(cur_value.get(), v.get()) > 0;
   }
 
   // unreachable - but gets rid of a warning in trusty
@@ -82,7 +103,7 @@ std::ostream& RelopQuery::Dump(std::ostream& os) const {
 
 meter::Tags RelopQuery::Tags() const noexcept {
   if (op_ == RelOp::EQ) {
-    return meter::Tags{{KeyRef(), intern_str(value_)}};
+    return meter::Tags{{KeyRef(), value_ref_}};
   }
   return meter::Tags();
 }
@@ -184,18 +205,35 @@ std::ostream& operator<<(std::ostream& os, const RelOp& op) {
   return os;
 }
 
+static std::unordered_set<StrRef> acquire_set(const StringRefs& vs) noexcept {
+  std::unordered_set<StrRef> res;
+  for (auto v : vs) {
+    auto ref = util::acquire_ref(v);
+    if (!res.insert(ref).second) {
+      util::release_ref(ref);
+    }
+  }
+  return res;
+}
+
 InQuery::InQuery(std::string key, std::unique_ptr<StringRefs> vs) noexcept
-    : AbstractKeyQuery(std::move(key)),
-      vs_(std::move(vs)) {}
+    : AbstractKeyQuery(std::move(key)), vs_(acquire_set(*vs)) {}
+
+InQuery::InQuery(StrRef key, std::unique_ptr<StringRefs> vs) noexcept
+    : AbstractKeyQuery(key), vs_(acquire_set(*vs)) {}
+
+InQuery::~InQuery() {
+  for (auto v : vs_) {
+    util::release_ref(v);
+  }
+}
 
 bool InQuery::Matches(const meter::Tags& tags) const {
-  auto value = getvalue(tags);
-  if (!value) {
+  auto value = getref(tags);
+  if (value.get() == nullptr) {
     return false;
   }
-  auto valueRef = intern_str(value.get());
-  return std::any_of(vs_->begin(), vs_->end(),
-                     [valueRef](util::StrRef& s) { return valueRef == s; });
+  return vs_.find(value) != vs_.end();
 }
 
 std::ostream& InQuery::Dump(std::ostream& os) const { return os; }
@@ -4,6 +4,7 @@
 #include "../util/optional.h"
 #include "expression.h"
 #include <pcre.h>
+#include <unordered_set>
 
 namespace atlas {
 namespace interpreter {
@@ -39,21 +40,32 @@ class AbstractKeyQuery : public Query {
  public:
   explicit AbstractKeyQuery(std::string key) noexcept;
 
+  explicit AbstractKeyQuery(util::StrRef key) noexcept;
+
+  ~AbstractKeyQuery() override { util::release_ref(key_ref_); }
+
   const std::string& Key() const noexcept;
 
   util::StrRef KeyRef() const noexcept;
 
  private:
   const std::string key_;
+  // resolved once so matching never goes through the string pool
+  const util::StrRef key_ref_;
 
  protected:
   const OptionalString getvalue(const meter::Tags& tags) const noexcept;
+
+  // the interned value for our key, or a null ref if the key is not present
+  util::StrRef getref(const meter::Tags& tags) const noexcept;
 };
 
 class HasKeyQuery : public AbstractKeyQuery {
  public:
   explicit HasKeyQuery(std::string key);
 
+  explicit HasKeyQuery(util::StrRef key);
+
   std::ostream& Dump(std::ostream& os) const override;
 
   bool Matches(const meter::Tags& tags) const override;
@@ -64,7 +76,7 @@ class HasKeyQuery : public AbstractKeyQuery {
     if (query.GetQueryType() != GetQueryType()) return false;
 
     const auto& q = static_cast<const HasKeyQuery&>(query);
-    return Key() == q.Key();
+    return KeyRef() == q.KeyRef();
   }
 };
 
@@ -76,12 +88,15 @@ class RelopQuery : public AbstractKeyQuery {
  public:
   RelopQuery(std::string k, std::string v, RelOp op);
 
+  RelopQuery(util::StrRef k, util::StrRef v, RelOp op);
+
+  ~RelopQuery() override { util::release_ref(value_ref_); }
+
   std::ostream& Dump(std::ostream& os) const override;
 
   bool Matches(const meter::Tags& tags) const override;
 
-  static bool do_query(const OptionalString& cur_value, const std::string& v,
-                       RelOp op);
+  static bool do_query(util::StrRef cur_value, util::StrRef v, RelOp op);
 
   meter::Tags Tags() const noexcept override;
 
@@ -89,7 +104,8 @@ class RelopQuery : public AbstractKeyQuery {
     if (query.GetQueryType() != GetQueryType()) return false;
 
     const auto& q = static_cast<const RelopQuery&>(query);
-    return Key() == q.Key() && op_ == q.op_ && value_ == q.value_;
+    return KeyRef() == q.KeyRef() && op_ == q.op_ &&
+           value_ref_ == q.value_ref_;
   }
 
   QueryType GetQueryType() const noexcept override { return QueryType::RelOp; }
@@ -97,6 +113,8 @@ class RelopQuery : public AbstractKeyQuery {
  private:
   RelOp op_;
   const std::string value_;
+  // resolved once so :eq can be matched with a pointer comparison
+  const util::StrRef value_ref_;
 };
 
 class RegexQuery : public AbstractKeyQuery {
@@ -114,7 +132,7 @@ class RegexQuery : public AbstractKeyQuery {
     if (query.GetQueryType() != GetQueryType()) return false;
 
     const auto& q = static_cast<const RegexQuery&>(query);
-    return Key() == q.Key() && str_pattern == q.str_pattern;
+    return KeyRef() == q.KeyRef() && str_pattern == q.str_pattern;
   }
 
   QueryType GetQueryType() const noexcept override { return QueryType::Regex; }
@@ -128,6 +146,10 @@ class InQuery : public AbstractKeyQuery {
  public:
   InQuery(std::string key, std::unique_ptr<StringRefs> vs) noexcept;
 
+  InQuery(util::StrRef key, std::unique_ptr<StringRefs> vs) noexcept;
+
+  ~InQuery() override;
+
   std::ostream& Dump(std::ostream& os) const override;
 
   bool Matches(const meter::Tags& tags) const override;
@@ -136,13 +158,13 @@ class InQuery : public AbstractKeyQuery {
     if (query.GetQueryType() != GetQueryType()) return false;
 
     const auto& q = static_cast<const InQuery&>(query);
-    return Key() == q.Key() && *vs_ == *(q.vs_);
+    return KeyRef() == q.KeyRef() && vs_ == q.vs_;
   }
 
   QueryType GetQueryType() const noexcept override { return QueryType::In; }
 
  private:
-  std::unique_ptr<StringRefs> vs_;
+  std::unordered_set<util::StrRef> vs_;
 };
 
 class TrueQuery : public Query {
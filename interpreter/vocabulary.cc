@@ -3,6 +3,7 @@
 #include "all.h"
 #include "group_by.h"
 #include "keep_drop_tags.h"
+#include <cstring>
 #include <sstream>
 
 namespace atlas {
@@ -13,7 +14,7 @@ namespace {
 class HasKeyWord : public Word {
  public:
   OptionalString Execute(Context* context) override {
-    const std::string& k = context->PopString();
+    auto k = context->PopRef();
     auto expression = std::make_unique<HasKeyQuery>(k);
     context->Push(std::move(expression));
     return kNone;
@@ -22,8 +23,8 @@ class HasKeyWord : public Word {
 
 OptionalString do_query(Context* context, RelOp op) {
   try {
-    const std::string v = context->PopString();
-    const std::string k = context->PopString();
+    auto v = context->PopRef();
+    auto k = context->PopRef();
     auto expression = std::make_unique<RelopQuery>(k, v, op);
     context->Push(std::move(expression));
     return kNone;
@@ -70,13 +71,13 @@ class LeWord : public Word {
 class InWord : public Word {
  public:
   OptionalString Execute(Context* context) override {
-    auto expr = context->PopExpression().get();
+    auto expr = context->PopExpression();
     if (expr->GetType() != ExpressionType::List) {
       return OptionalString(":in expects a list on the stack");
     }
 
-    auto list = static_cast<List*>(expr);
-    auto key = context->PopString();
+    auto list = static_cast<List*>(expr.get());
+    auto key = context->PopRef();
     auto in_expr = std::make_unique<InQuery>(key, list->ToStrings());
     context->Push(std::move(in_expr));
     return kNone;
@@ -325,44 +326,124 @@ class GroupByWord : public Word {
         "query on the stack");
   }
 };
+
+enum WordId {
+  kHas,
+  kEq,
+  kGt,
+  kGe,
+  kLt,
+  kLe,
+  kIn,
+  kRe,
+  kReic,
+  kNot,
+  kAnd,
+  kOr,
+  kFalse,
+  kTrue,
+  kCount,
+  kSum,
+  kMin,
+  kMax,
+  kAvg,
+  kBy,
+  kKeepTags,
+  kDropTags,
+  kAll,
+  kNumWords,
+  kUnknownWord = kNumWords
+};
+
+inline bool is(const char* word, const char* name, size_t size) {
+  return memcmp(word, name, size) == 0;
+}
+
+// resolve a word without allocating or hashing: the length of the word
+// narrows it down to a few candidates
+WordId GetWordId(const char* w, size_t n) noexcept {
+  switch (n) {
+    case 2:
+      if (is(w, "eq", n)) return kEq;
+      if (is(w, "by", n)) return kBy;
+      if (is(w, "in", n)) return kIn;
+      if (is(w, "re", n)) return kRe;
+      if (is(w, "or", n)) return kOr;
+      if (is(w, "gt", n)) return kGt;
+      if (is(w, "ge", n)) return kGe;
+      if (is(w, "lt", n)) return kLt;
+      if (is(w, "le", n)) return kLe;
+      break;
+    case 3:
+      if (is(w, "and", n)) return kAnd;
+      if (is(w, "sum", n)) return kSum;
+      if (is(w, "has", n)) return kHas;
+      if (is(w, "not", n)) return kNot;
+      if (is(w, "all", n)) return kAll;
+      if (is(w, "max", n)) return kMax;
+      if (is(w, "min", n)) return kMin;
+      if (is(w, "avg", n)) return kAvg;
+      break;
+    case 4:
+      if (is(w, "true", n)) return kTrue;
+      if (is(w, "reic", n)) return kReic;
+      break;
+    case 5:
+      if (is(w, "count", n)) return kCount;
+      if (is(w, "false", n)) return kFalse;
+      break;
+    case 9:
+      if (is(w, "keep-tags", n)) return kKeepTags;
+      if (is(w, "drop-tags", n)) return kDropTags;
+      break;
+    default:
+      break;
+  }
+  return kUnknownWord;
+}
 }  // namespace
 
-ClientVocabulary::ClientVocabulary() {
+ClientVocabulary::ClientVocabulary() : words(kNumWords) {
   // query words
-  words["has"] = std::make_unique<HasKeyWord>();
-  words["eq"] = std::make_unique<EqualWord>();
-  words["gt"] = std::make_unique<GtWord>();
-  words["ge"] = std::make_unique<GeWord>();
-  words["lt"] = std::make_unique<LtWord>();
-  words["le"] = std::make_unique<LeWord>();
-  words["in"] = std::make_unique<InWord>();
-  words["re"] = std::make_unique<RegexWord>(false);
-  words["reic"] = std::make_unique<RegexWord>(true);
-  words["not"] = std::make_unique<NotWord>();
-  words["and"] = std::make_unique<AndWord>();
-  words["or"] = std::make_unique<OrWord>();
-  words["false"] = std::make_unique<FalseWord>();
-  words["true"] = std::make_unique<TrueWord>();
+  words[kHas] = std::make_unique<HasKeyWord>();
+  words[kEq] = std::make_unique<EqualWord>();
+  words[kGt] = std::make_unique<GtWord>();
+  words[kGe] = std::make_unique<GeWord>();
+  words[kLt] = std::make_unique<LtWord>();
+  words[kLe] = std::make_unique<LeWord>();
+  words[kIn] = std::make_unique<InWord>();
+  words[kRe] = std::make_unique<RegexWord>(false);
+  words[kReic] = std::make_unique<RegexWord>(true);
+  words[kNot] = std::make_unique<NotWord>();
+  words[kAnd] = std::make_unique<AndWord>();
+  words[kOr] = std::make_unique<OrWord>();
+  words[kFalse] = std::make_unique<FalseWord>();
+  words[kTrue] = std::make_unique<TrueWord>();
   // aggregation words
-  words["count"] = std::make_unique<CountWord>();
-  words["sum"] = std::make_unique<SumWord>();
-  words["min"] = std::make_unique<MinWord>();
-  words["max"] = std::make_unique<MaxWord>();
-  words["avg"] = std::make_unique<AvgWord>();
+  words[kCount] = std::make_unique<CountWord>();
+  words[kSum] = std::make_unique<SumWord>();
+  words[kMin] = std::make_unique<MinWord>();
+  words[kMax] = std::make_unique<MaxWord>();
+  words[kAvg] = std::make_unique<AvgWord>();
   // by
-  words["by"] = std::make_unique<GroupByWord>();
-  words["keep-tags"] = std::make_unique<DropKeepTagsWord>(true);
-  words["drop-tags"] = std::make_unique<DropKeepTagsWord>(false);
-  words["all"] = std::make_unique<AllWord>();
+  words[kBy] = std::make_unique<GroupByWord>();
+  words[kKeepTags] = std::make_unique<DropKeepTagsWord>(true);
+  words[kDropTags] = std::make_unique<DropKeepTagsWord>(false);
+  words[kAll] = std::make_unique<AllWord>();
 }
 
 OptionalString ClientVocabulary::Execute(Context* context,
                                          const std::string& token) const {
-  auto w = words.find(token);
-  if (w == words.end()) {
-    return OptionalString{"Unknown word " + token};
+  return Execute(context, token.c_str(), token.length());
+}
+
+OptionalString ClientVocabulary::Execute(Context* context, const char* word,
+                                         size_t size) const {
+  auto id = GetWordId(word, size);
+  if (id == kUnknownWord) {
+    return OptionalString{"Unknown word " + std::string(word, size)};
   }
-  return w->second->Execute(context);
+  return words[id]->Execute(context);
 }
 }  // namespace interpreter
 }  // namespace atlas
@@ -10,6 +10,14 @@ class Vocabulary {
  public:
   virtual OptionalString Execute(Context* context,
                                  const std::string& token) const = 0;
+
+  /// execute a word that is a slice of a larger program. The default
+  /// implementation copies the word and calls Execute(context, token)
+  virtual OptionalString Execute(Context* context, const char* word,
+                                 size_t size) const {
+    return Execute(context, std::string(word, size));
+  }
+
   virtual ~Vocabulary() = default;
 };
 
@@ -21,8 +29,12 @@ class ClientVocabulary : public Vocabulary {
   OptionalString Execute(Context* context,
                          const std::string& token) const override;
 
+  OptionalString Execute(Context* context, const char* word,
+                         size_t size) const override;
+
  private:
-  std::map<std::string, std::unique_ptr<Word>> words;
+  // indexed by the id of the word, see WordId in vocabulary.cc
+  std::vector<std::unique_ptr<Word>> words;
 };
 }  // namespace interpreter
 }  // namespace atlas
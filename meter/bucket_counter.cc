@@ -6,7 +6,8 @@ BucketCounter::BucketCounter(Registry* registry, IdPtr id,
                              BucketFunction bucket_function)
     : Meter{id, registry->clock()},
       registry_{registry},
-      bucket_function_{std::move(bucket_function)} {}
+      bucket_function_{std::move(bucket_function)},
+      bucket_ids_{id_, bucket_function_} {}
 
 std::ostream& BucketCounter::Dump(std::ostream& os) const {
   os << "BucketCounter{" << *id_ << "}";
@@ -18,11 +19,9 @@ Measurements BucketCounter::MeasuresForPoller(size_t /*poller_idx*/) const {
   return kEmptyMeasurements;
 }
 
-static const std::string kBucket{"bucket"};
-
 void BucketCounter::Record(int64_t amount) noexcept {
-  const auto& bucket = bucket_function_(amount);
-  registry_->counter(id_->WithTag(Tag::of(kBucket, bucket)))->Increment();
+  auto bucket = bucket_function_.IndexOf(amount);
+  registry_->counter(bucket_ids_.For(bucket))->Increment();
   Updated();
 }
 
@@ -7,7 +7,8 @@ BucketDistributionSummary::BucketDistributionSummary(
     Registry* registry, IdPtr id, BucketFunction bucket_function)
     : Meter{id, registry->clock()},
       registry_{registry},
-      bucket_function_{std::move(bucket_function)} {}
+      bucket_function_{std::move(bucket_function)},
+      bucket_ids_{id_, bucket_function_} {}
 
 std::ostream& BucketDistributionSummary::Dump(std::ostream& os) const {
   os << "BucketDistributionSummary{" << *id_ << "}";
@@ -20,12 +21,9 @@ Measurements BucketDistributionSummary::MeasuresForPoller(
   return kEmptyMeasurements;
 }
 
-static const std::string kBucket{"bucket"};
-
 void BucketDistributionSummary::Record(int64_t amount) noexcept {
-  const auto& bucket = bucket_function_(amount);
-  registry_->distribution_summary(id_->WithTag(Tag::of(kBucket, bucket)))
-      ->Record(amount);
+  auto bucket = bucket_function_.IndexOf(amount);
+  registry_->distribution_summary(bucket_ids_.For(bucket))->Record(amount);
   Updated();
 }
 
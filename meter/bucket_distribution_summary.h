@@ -1,6 +1,7 @@
 #pragma once
 
 #include "bucket_functions.h"
+#include "bucket_ids.h"
 #include "counter.h"
 #include "meter.h"
 #include "registry.h"
@@ -20,6 +21,7 @@ class BucketDistributionSummary : public Meter, public DistributionSummary {
  private:
   Registry* registry_;
   BucketFunction bucket_function_;
+  BucketIds bucket_ids_;
 };
 }  // namespace meter
 }  // namespace atlas
@@ -11,40 +11,8 @@ namespace meter {
 namespace bucket_functions {
 namespace {
 
-class Bucket {
- public:
-  Bucket(std::string name, int64_t upper_boundary) noexcept
-      : name_{std::move(name)},
-        upper_boundary_{upper_boundary} {}
-
-  std::string Name() const noexcept { return name_; }
-  int64_t UpperBoundary() const noexcept { return upper_boundary_; }
-
- private:
-  std::string name_;
-  int64_t upper_boundary_;
-};
-
+using Bucket = BucketFunction::Bucket;
 using Buckets = std::vector<Bucket>;
-class BucketsFunction {
- public:
-  BucketsFunction(Buckets&& buckets, std::string&& fallback) noexcept
-      : buckets_{buckets},
-        fallback_{fallback} {}
-
-  std::string operator()(int64_t amount) {
-    for (const auto& b : buckets_) {
-      if (amount <= b.UpperBoundary()) {
-        return b.Name();
-      }
-    }
-    return fallback_;
-  }
-
- private:
-  Buckets buckets_;
-  std::string fallback_;
-};
 
 /// Format a value as a bucket label
 class ValueFormatter {
@@ -207,41 +175,37 @@ const ValueFormatter& GetFormatter(const ValueFormatters& vfs, int64_t max) {
   return vfs[vfs.size() - 1];
 }
 
-std::function<std::string(int64_t)> BiasZero(const char* ltZero,
-                                             const char* gtMax, int64_t max,
-                                             const ValueFormatter& vf) {
+BucketFunction BiasZero(const char* ltZero, const char* gtMax, int64_t max,
+                        const ValueFormatter& vf) {
   Buckets buckets;
-  buckets.emplace_back(std::string{ltZero}, -1);
-  buckets.emplace_back(vf.NewBucket(max / 8));
-  buckets.emplace_back(vf.NewBucket(max / 4));
-  buckets.emplace_back(vf.NewBucket(max / 2));
-  buckets.emplace_back(vf.NewBucket(max));
-  return BucketsFunction(std::move(buckets), gtMax);
+  buckets.push_back(Bucket{ltZero, -1});
+  buckets.push_back(vf.NewBucket(max / 8));
+  buckets.push_back(vf.NewBucket(max / 4));
+  buckets.push_back(vf.NewBucket(max / 2));
+  buckets.push_back(vf.NewBucket(max));
+  return BucketFunction(std::move(buckets), gtMax);
 }
 
-std::function<std::string(int64_t)> BiasMax(const char* ltZero,
-                                            const char* gtMax, int64_t max,
-                                            const ValueFormatter& vf) {
+BucketFunction BiasMax(const char* ltZero, const char* gtMax, int64_t max,
+                       const ValueFormatter& vf) {
   Buckets buckets;
-  buckets.emplace_back(std::string{ltZero}, -1);
-  buckets.emplace_back(vf.NewBucket(max - max / 2));
-  buckets.emplace_back(vf.NewBucket(max - max / 4));
-  buckets.emplace_back(vf.NewBucket(max - max / 8));
-  buckets.emplace_back(vf.NewBucket(max));
-  return BucketsFunction(std::move(buckets), gtMax);
+  buckets.push_back(Bucket{ltZero, -1});
+  buckets.push_back(vf.NewBucket(max - max / 2));
+  buckets.push_back(vf.NewBucket(max - max / 4));
+  buckets.push_back(vf.NewBucket(max - max / 8));
+  buckets.push_back(vf.NewBucket(max));
+  return BucketFunction(std::move(buckets), gtMax);
 }
 
-std::function<std::string(int64_t)> TimeBiasZero(const char* ltZero,
-                                                 const char* gtMax,
-                                                 nanoseconds nanos) {
+BucketFunction TimeBiasZero(const char* ltZero, const char* gtMax,
+                            nanoseconds nanos) {
   const auto v = nanos.count();
   const auto& f = GetFormatter(GetTimeFormatters(), v);
   return BiasZero(ltZero, gtMax, v, f);
 }
 
-std::function<std::string(int64_t)> TimeBiasMax(const char* ltZero,
-                                                const char* gtMax,
-                                                nanoseconds nanos) {
+BucketFunction TimeBiasMax(const char* ltZero, const char* gtMax,
+                           nanoseconds nanos) {
   const auto v = nanos.count();
   const auto& f = GetFormatter(GetTimeFormatters(), v);
   return BiasMax(ltZero, gtMax, v, f);
@@ -1,12 +1,50 @@
 #pragma once
 #include <chrono>
-#include <functional>
 #include <string>
+#include <vector>
 
 namespace atlas {
 namespace meter {
 
-using BucketFunction = std::function<std::string(int64_t)>;
+/// Maps values to one of a fixed set of labeled buckets. Buckets are numbered
+/// so meters can precompute what they need for each of them
+class BucketFunction {
+ public:
+  struct Bucket {
+    std::string name;
+    int64_t upper_boundary;
+  };
+
+  BucketFunction(std::vector<Bucket> buckets, std::string fallback) noexcept
+      : buckets_{std::move(buckets)}, fallback_{std::move(fallback)} {}
+
+  /// number of buckets, including the one for values past the last boundary
+  size_t Size() const noexcept { return buckets_.size() + 1; }
+
+  /// the index of the bucket for amount
+  size_t IndexOf(int64_t amount) const noexcept {
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      if (amount <= buckets_[i].upper_boundary) {
+        return i;
+      }
+    }
+    return buckets_.size();
+  }
+
+  /// the label of the bucket with the given index
+  const std::string& Name(size_t index) const noexcept {
+    return index < buckets_.size() ? buckets_[index].name : fallback_;
+  }
+
+  const std::string& operator()(int64_t amount) const noexcept {
+    return Name(IndexOf(amount));
+  }
+
+ private:
+  std::vector<Bucket> buckets_;
+  std::string fallback_;
+};
+
 namespace bucket_functions {
 
 ///
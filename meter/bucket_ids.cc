@@ -0,0 +1,16 @@
+#include "bucket_ids.h"
+
+namespace atlas {
+namespace meter {
+
+static const std::string kBucket{"bucket"};
+
+BucketIds::BucketIds(const IdPtr& id, const BucketFunction& bucket_function) {
+  ids_.reserve(bucket_function.Size());
+  for (size_t i = 0; i < bucket_function.Size(); ++i) {
+    ids_.push_back(id->WithTag(Tag::of(kBucket, bucket_function.Name(i))));
+  }
+}
+
+}  // namespace meter
+}  // namespace atlas
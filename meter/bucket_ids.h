@@ -0,0 +1,25 @@
+#pragma once
+
+#include "bucket_functions.h"
+#include "id.h"
+#include <vector>
+
+namespace atlas {
+namespace meter {
+
+/// The ids of the meters a bucket meter updates, derived for every bucket of
+/// its bucket function when the meter is created, so recording only indexes
+/// into them
+class BucketIds {
+ public:
+  BucketIds(const IdPtr& id, const BucketFunction& bucket_function);
+
+  /// the id with the tag for the bucket with the given index
+  const IdPtr& For(size_t bucket) const noexcept { return ids_[bucket]; }
+
+ private:
+  std::vector<IdPtr> ids_;
+};
+
+}  // namespace meter
+}  // namespace atlas
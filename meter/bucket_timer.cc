@@ -6,7 +6,8 @@ BucketTimer::BucketTimer(Registry* registry, IdPtr id,
                          BucketFunction bucket_function)
     : Meter{id, registry->clock()},
       registry_{registry},
-      bucket_function_{std::move(bucket_function)} {}
+      bucket_function_{std::move(bucket_function)},
+      bucket_ids_{id_, bucket_function_} {}
 
 std::ostream& BucketTimer::Dump(std::ostream& os) const {
   os << "BucketTimer{" << *id_ << "}";
@@ -18,11 +19,9 @@ Measurements BucketTimer::MeasuresForPoller(size_t /*poller_idx*/) const {
   return kEmptyMeasurements;
 }
 
-static const std::string kBucket{"bucket"};
-
 void BucketTimer::Record(std::chrono::nanoseconds duration) {
-  const auto& bucket = bucket_function_(duration.count());
-  registry_->timer(id_->WithTag(Tag::of(kBucket, bucket)))->Record(duration);
+  auto bucket = bucket_function_.IndexOf(duration.count());
+  registry_->timer(bucket_ids_.For(bucket))->Record(duration);
   Updated();
 }
 
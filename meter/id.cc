@@ -1,6 +1,8 @@
 #include "id.h"
 #include "../util/dump.h"
+#include "../util/xxhash.h"
 #include "statistic.h"
+#include <atomic>
 
 namespace atlas {
 namespace meter {
@@ -9,16 +11,193 @@ const Tags kEmptyTags;
 
 const char* Id::Name() const noexcept { return name_.get(); }
 
-const Tags& Id::GetTags() const noexcept { return tags_; }
+void Tags::acquire_refs() noexcept {
+  auto moved = false;
+  for (auto& tag : entries_) {
+    auto k = util::acquire_ref(tag.first);
+    auto v = util::acquire_ref(tag.second);
+    moved = moved || !(k == tag.first) || !(v == tag.second);
+    tag.first = k;
+    tag.second = v;
+  }
+  if (moved) {
+    std::sort(entries_.begin(), entries_.end(),
+              [](const Entry& a, const Entry& b) {
+                return key_less(a, b.first);
+              });
+    hash_ = 0;
+    for (const auto& tag : entries_) {
+      hash_ += entry_hash(tag);
+    }
+  }
+}
+
+void Tags::release_refs() const noexcept {
+  for (const auto& tag : entries_) {
+    util::release_ref(tag.first);
+    util::release_ref(tag.second);
+  }
+}
+
+void CountedTags::add(const char* k, const char* v) noexcept {
+  Tags updated(tags_);
+  updated.add(k, v);
+  *this = CountedTags{std::move(updated)};
+}
+
+void CountedTags::add_all(const Tags& source) noexcept {
+  Tags updated(tags_);
+  updated.add_all(source);
+  *this = CountedTags{std::move(updated)};
+}
+
+// The tags of an id. Roots own a flat set of tags. Derived storage refers
+// to the one of its parent and adds or replaces a single tag, so its flat
+// tags are only put together when they are asked for
+class Id::Storage {
+ public:
+  explicit Storage(Tags tags) noexcept
+      : root_(std::move(tags)),
+        tag_{util::StrRef(), util::StrRef()},
+        hash_(root_.get().hash()),
+        size_(root_.get().size()),
+        depth_(0),
+        flat_(&root_.get()) {}
+
+  Storage(std::shared_ptr<const Storage> parent, const Tag& tag) noexcept
+      : parent_(std::move(parent)),
+        tag_{util::acquire_ref(tag.key), util::acquire_ref(tag.value)},
+        hash_(parent_->hash_ + Tags::entry_hash(tag_)),
+        size_(parent_->size_),
+        depth_(parent_->depth_ + 1),
+        flat_(nullptr) {
+    auto replaced = parent_->Find(tag_.first);
+    if (replaced.get() == nullptr) {
+      ++size_;
+    } else {
+      hash_ -= Tags::entry_hash(Tags::Entry{tag_.first, replaced});
+    }
+  }
+
+  Storage(const Storage&) = delete;
+  Storage& operator=(const Storage&) = delete;
+
+  ~Storage() {
+    if (parent_) {
+      util::release_ref(tag_.first);
+      util::release_ref(tag_.second);
+      delete flat_.load();
+    }
+  }
+
+  // derived storage is flattened once it is this deep, so lookups stay
+  // cheap when ids are derived from derived ids in a loop
+  static constexpr size_t kMaxDepth = 8;
+
+  const Tags& Get() const noexcept {
+    auto flat = flat_.load(std::memory_order_acquire);
+    if (flat != nullptr) {
+      return *flat;
+    }
+    auto built = new Tags(parent_->Get());
+    built->add(tag_.first, tag_.second);
+    if (flat_.compare_exchange_strong(flat, built)) {
+      return *built;
+    }
+    delete built;
+    return *flat;
+  }
+
+  // the value for key, or a null ref
+  util::StrRef Find(util::StrRef key) const noexcept {
+    auto storage = this;
+    for (; storage->parent_; storage = storage->parent_.get()) {
+      if (storage->tag_.first == key) {
+        return storage->tag_.second;
+      }
+    }
+    const auto& tags = storage->root_.get();
+    auto it = tags.find(key);
+    return it != tags.end() ? it->second : util::StrRef();
+  }
+
+  bool Equals(const Storage& other) const noexcept {
+    if (this == &other) {
+      return true;
+    }
+    if (hash_ != other.hash_ || size_ != other.size_) {
+      return false;
+    }
+    // the usual case: the same tag derived again from the same id
+    if (parent_ && parent_ == other.parent_) {
+      return tag_.first == other.tag_.first && tag_.second == other.tag_.second;
+    }
+    return Get() == other.Get();
+  }
+
+  uint64_t hash() const noexcept { return hash_; }
+
+  size_t depth() const noexcept { return depth_; }
+
+ private:
+  CountedTags root_;
+  std::shared_ptr<const Storage> parent_;
+  Tags::Entry tag_;
+  uint64_t hash_;
+  size_t size_;
+  size_t depth_;
+  mutable std::atomic<const Tags*> flat_;
+};
+
+static uint64_t FingerprintOf(util::StrRef name, uint64_t tags_hash) noexcept {
+  uint64_t parts[] = {reinterpret_cast<uintptr_t>(name.get()), tags_hash};
+  return XXH64(parts, sizeof parts, 0);
+}
+
+Id::Id(util::StrRef name, Tags tags) noexcept
+    : Id(util::acquire_ref(name), std::make_shared<Storage>(std::move(tags))) {}
+
+Id::Id(const std::string& name, Tags tags) noexcept
+    : Id(util::acquire_str(name), std::make_shared<Storage>(std::move(tags))) {
+}
+
+Id::Id(util::StrRef name, std::shared_ptr<const Storage> tags) noexcept
+    : name_(name),
+      tags_(std::move(tags)),
+      fingerprint_(FingerprintOf(name_, tags_->hash())) {}
+
+const Tags& Id::GetTags() const noexcept { return tags_->Get(); }
+
+bool Id::HasTag(util::StrRef key) const noexcept {
+  return tags_->Find(key).get() != nullptr;
+}
+
+IdPtr Id::WithTag(const Tag& tag) const {
+  if (tags_->Find(tag.key) == tag.value) {
+    return std::make_shared<Id>(*this);
+  }
+  std::shared_ptr<const Storage> tags;
+  if (tags_->depth() < Storage::kMaxDepth) {
+    tags = std::make_shared<Storage>(tags_, tag);
+  } else {
+    Tags flat(tags_->Get());
+    flat.add(tag);
+    tags = std::make_shared<Storage>(std::move(flat));
+  }
+  return IdPtr(new Id(util::acquire_ref(name_), std::move(tags)));
+}
 
-std::unique_ptr<Id> Id::WithTag(const Tag& tag) const {
-  Tags new_tags(tags_);
-  new_tags.add(tag);
-  return std::make_unique<Id>(name_, new_tags);
+IdPtr Id::WithTags(std::initializer_list<Tag> tags) const {
+  auto id = std::make_shared<Id>(*this);
+  for (const auto& tag : tags) {
+    id = id->WithTag(tag);
+  }
+  return id;
 }
 
 bool Id::operator==(const Id& rhs) const noexcept {
-  return std::tie(name_, tags_) == std::tie(rhs.name_, rhs.tags_);
+  return fingerprint_ == rhs.fingerprint_ && name_ == rhs.name_ &&
+         tags_->Equals(*rhs.tags_);
 }
 
 std::ostream& operator<<(std::ostream& os, const Id& id) {
@@ -29,7 +208,7 @@ std::ostream& operator<<(std::ostream& os, const Id& id) {
 }
 
 IdPtr WithDefaultTagForId(IdPtr id, const Tag& default_tag) {
-  bool already_has_key = id->GetTags().has(default_tag.key);
+  bool already_has_key = id->HasTag(default_tag.key);
   return already_has_key ? id : id->WithTag(default_tag);
 }
 
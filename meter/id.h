@@ -1,10 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <ostream>
 #include <unordered_map>
 #include "../types.h"
 #include "../util/intern.h"
+#include "../util/small_vector.h"
 
 namespace atlas {
 namespace meter {
@@ -23,63 +26,178 @@ struct Tag {
   }
 };
 
+// Tags are kept sorted by key in a flat vector, with a hash that is updated
+// as tags are added. Since strings are interned, comparing two sets of tags
+// only compares pointers. Tags do not hold references to their strings, so
+// copying them is cheap. Owners that keep tags for longer than a sweep
+// interval of the string pool use CountedTags, or acquire_refs
 class Tags {
   using K = util::StrRef;
-  using table_t = std::unordered_map<K, K>;
-  using value_t = table_t::value_type;
-  table_t entries_;
 
-  static inline table_t to_str_refs(
-      std::initializer_list<std::pair<const char*, const char*>>(vs)) {
-    table_t res;
-    for (const auto& pair : vs) {
-      res.insert(std::make_pair(util::intern_str(pair.first),
-                                util::intern_str(pair.second)));
+ public:
+  struct Entry {
+    K first;
+    K second;
+  };
+
+  /// The hash of a single tag. The hash of a set of tags is the sum of the
+  /// hashes of its entries, so it can be updated as tags change
+  static uint64_t entry_hash(const Entry& entry) noexcept {
+    auto k = reinterpret_cast<uintptr_t>(entry.first.get());
+    auto v = reinterpret_cast<uintptr_t>(entry.second.get());
+    uint64_t h = (k ^ (v * 0x9E3779B97F4A7C15ull)) * 0xC2B2AE3D27D4EB4Full;
+    return h ^ (h >> 29);
+  }
+
+ private:
+  static constexpr size_t kInlineTags = 10;
+  using entries_t = util::SmallVector<Entry, kInlineTags>;
+  entries_t entries_;
+  uint64_t hash_ = 0;
+
+  static bool key_less(const Entry& entry, const K& key) noexcept {
+    return std::less<const char*>()(entry.first.get(), key.get());
+  }
+
+  Entry* lower_bound(K key) noexcept {
+    return std::lower_bound(entries_.begin(), entries_.end(), key, key_less);
+  }
+
+  // intern a string without keeping a reference to it, so it is valid for
+  // the grace period of the string pool
+  static K transient_str(const char* string) noexcept {
+    auto ref = util::acquire_str(string);
+    util::release_ref(ref);
+    return ref;
+  }
+
+  // add a tag unless the key is present. Returns whether it was added
+  bool insert(const Entry& entry) noexcept {
+    auto it = lower_bound(entry.first);
+    if (it != entries_.end() && it->first == entry.first) {
+      return false;
     }
-    return res;
+    entries_.insert(it, entry);
+    hash_ += entry_hash(entry);
+    return true;
   }
 
  public:
-  Tags() = default;
+  using const_iterator = const Entry*;
+
+  Tags() noexcept {}
 
-  Tags(std::initializer_list<value_t> vs) : entries_(vs) {}
+  Tags(std::initializer_list<Entry> vs) {
+    entries_.reserve(vs.size());
+    for (const auto& tag : vs) {
+      insert(tag);
+    }
+  }
 
-  Tags(std::initializer_list<std::pair<const char*, const char*>> vs)
-      : entries_(to_str_refs(vs)) {}
+  Tags(std::initializer_list<std::pair<const char*, const char*>> vs) {
+    entries_.reserve(vs.size());
+    for (const auto& pair : vs) {
+      insert(Entry{transient_str(pair.first), transient_str(pair.second)});
+    }
+  }
 
-  void add(const Tag& tag) { entries_[tag.key] = tag.value; }
+  Tags(const Tags& other) = default;
 
-  void add(K k, K v) { entries_[k] = v; }
+  Tags(Tags&& other) noexcept : entries_(std::move(other.entries_)),
+                                hash_(other.hash_) {
+    other.hash_ = 0;
+  }
 
-  void add(const char* k, const char* v) {
-    entries_[util::intern_str(k)] = util::intern_str(v);
+  Tags& operator=(const Tags& other) = default;
+
+  Tags& operator=(Tags&& other) noexcept {
+    entries_ = std::move(other.entries_);
+    hash_ = other.hash_;
+    other.hash_ = 0;
+    return *this;
   }
 
-  size_t hash() const {
-    size_t res = 0;
-    for (const auto& tag : entries_) {
-      res += std::hash<K>()(tag.first) ^ std::hash<K>()(tag.second);
+  /// The tags in first, plus the ones in second with keys that are not in
+  /// first. Cheaper than copying first and calling add_all since both are
+  /// sorted
+  static Tags Merge(const Tags& first, const Tags& second) {
+    Tags res;
+    res.entries_.reserve(first.size() + second.size());
+    auto a = first.entries_.begin();
+    auto b = second.entries_.begin();
+    auto a_end = first.entries_.end();
+    auto b_end = second.entries_.end();
+    while (a != a_end || b != b_end) {
+      const Entry* next;
+      if (b == b_end || (a != a_end && key_less(*a, b->first))) {
+        next = a++;
+      } else if (a == a_end || key_less(*b, a->first)) {
+        next = b++;
+      } else {
+        next = a++;
+        ++b;
+      }
+      res.entries_.push_back(*next);
+      res.hash_ += entry_hash(*next);
     }
     return res;
   }
 
+  void add(const Tag& tag) { add(tag.key, tag.value); }
+
+  void add(K k, K v) {
+    auto it = lower_bound(k);
+    if (it == entries_.end() || !(it->first == k)) {
+      Entry tag{k, v};
+      entries_.insert(it, tag);
+      hash_ += entry_hash(tag);
+    } else if (!(it->second == v)) {
+      hash_ -= entry_hash(*it);
+      it->second = v;
+      hash_ += entry_hash(*it);
+    }
+  }
+
+  void add(const char* k, const char* v) {
+    add(transient_str(k), transient_str(v));
+  }
+
+  size_t hash() const { return static_cast<size_t>(hash_); }
+
   void add_all(const Tags& source) {
-    entries_.insert(source.entries_.begin(), source.entries_.end());
+    entries_.reserve(entries_.size() + source.size());
+    for (const auto& tag : source.entries_) {
+      insert(tag);
+    }
   }
 
-  bool operator==(const Tags& that) const { return that.entries_ == entries_; }
+  /// Take a reference to each string. Strings that were reclaimed during the
+  /// grace period are interned again, which changes their refs
+  void acquire_refs() noexcept;
 
-  table_t::const_iterator begin() const { return entries_.begin(); }
+  /// give back the references taken with acquire_refs
+  void release_refs() const noexcept;
+
+  bool operator==(const Tags& that) const {
+    return hash_ == that.hash_ && entries_.size() == that.entries_.size() &&
+           memcmp(entries_.begin(), that.entries_.begin(),
+                  entries_.size() * sizeof(Entry)) == 0;
+  }
 
-  table_t::const_iterator end() const { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
 
-  bool has(K key) const { return entries_.count(key) == 1; }
+  const_iterator end() const { return entries_.end(); }
 
-  table_t::const_iterator find(const K& k) const { return entries_.find(k); }
+  bool has(K key) const { return find(key) != end(); }
+
+  const_iterator find(const K& k) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), k, key_less);
+    return it != entries_.end() && it->first == k ? it : end();
+  }
 
   K at(K key) const {
-    auto it = entries_.find(key);
-    if (it != entries_.end()) {
+    auto it = find(key);
+    if (it != end()) {
       return it->second;
     }
     return util::intern_str("");  // cannot throw exceptions on nodejs
@@ -90,15 +208,47 @@ class Tags {
 
 extern const Tags kEmptyTags;
 
+/// Tags for owners that keep them for longer than a sweep interval of the
+/// string pool, like ids and the configuration. They hold a reference to
+/// each of their strings, which makes them more expensive to copy
+class CountedTags {
+ public:
+  CountedTags() noexcept {}
+  explicit CountedTags(Tags tags) noexcept : tags_(std::move(tags)) {
+    tags_.acquire_refs();
+  }
+  CountedTags(const CountedTags& other) noexcept : CountedTags(other.tags_) {}
+  CountedTags(CountedTags&& other) noexcept : tags_(std::move(other.tags_)) {}
+  CountedTags& operator=(CountedTags other) noexcept {
+    std::swap(tags_, other.tags_);
+    return *this;
+  }
+  ~CountedTags() { tags_.release_refs(); }
+
+  const Tags& get() const noexcept { return tags_; }
+
+  void add(const char* k, const char* v) noexcept;
+
+  void add_all(const Tags& source) noexcept;
+
+ private:
+  Tags tags_;
+};
+
+class Id;
+using IdPtr = std::shared_ptr<Id>;
+
+/// Ids are immutable. Copies of an id share its tags, and ids derived from
+/// it with WithTag share them too, adding a single tag on top
 class Id {
  public:
-  Id(util::StrRef name, Tags tags) noexcept : name_(name),
-                                              tags_(std::move(tags)),
-                                              hash_(0u) {}
-  Id(const std::string& name, Tags tags) noexcept
-      : name_(util::intern_str(name)),
-        tags_(std::move(tags)),
-        hash_(0u) {}
+  Id(util::StrRef name, Tags tags) noexcept;
+  Id(const std::string& name, Tags tags) noexcept;
+  Id(const Id& other) noexcept : name_(util::acquire_ref(other.name_)),
+                                 tags_(other.tags_),
+                                 fingerprint_(other.fingerprint_) {}
+  Id& operator=(const Id& other) = delete;
+  ~Id() { util::release_ref(name_); }
 
   bool operator==(const Id& rhs) const noexcept;
 
@@ -106,9 +256,23 @@ class Id {
 
   util::StrRef NameRef() const noexcept { return name_; };
 
+  /// 64-bit hash of the name and tags, computed when the id is created
+  uint64_t Fingerprint() const noexcept { return fingerprint_; }
+
+  /// The tags of the id. For derived ids they are put together the first
+  /// time they are needed
   const Tags& GetTags() const noexcept;
 
-  std::unique_ptr<Id> WithTag(const Tag& tag) const;
+  /// whether the id has a tag with the given key, without putting together
+  /// the tags of derived ids
+  bool HasTag(util::StrRef key) const noexcept;
+
+  /// A new id with the given tag added, or replaced if the key is present.
+  /// It shares the tags of this id, so deriving does not copy them
+  IdPtr WithTag(const Tag& tag) const;
+
+  /// Like chaining calls to WithTag
+  IdPtr WithTags(std::initializer_list<Tag> tags) const;
 
   friend std::ostream& operator<<(std::ostream& os, const Id& id);
 
@@ -117,22 +281,17 @@ class Id {
   friend struct std::hash<std::shared_ptr<Id>>;
 
  private:
+  class Storage;
   util::StrRef name_;
-  Tags tags_;
-  mutable size_t hash_;
+  std::shared_ptr<const Storage> tags_;
+  const uint64_t fingerprint_;
 
-  size_t Hash() const noexcept {
-    if (hash_ == 0) {
-      // compute hash code, and reuse it
-      hash_ = tags_.hash() ^ std::hash<atlas::util::StrRef>()(name_);
-    }
+  // takes over the reference to name
+  Id(util::StrRef name, std::shared_ptr<const Storage> tags) noexcept;
 
-    return hash_;
-  }
+  size_t Hash() const noexcept { return static_cast<size_t>(fingerprint_); }
 };
 
-using IdPtr = std::shared_ptr<Id>;
-
 IdPtr WithDefaultTagForId(IdPtr id, const Tag& default_tag);
 
 IdPtr WithDefaultGaugeTags(IdPtr id);
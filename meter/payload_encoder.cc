@@ -0,0 +1,414 @@
+#include "payload_encoder.h"
+#include "../util/json_writer.h"
+#include "../util/strings.h"
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace atlas {
+namespace meter {
+
+static bool ShouldSend(const interpreter::TagsValuePair& measure,
+                       validation::ValidationCache* validation) {
+  return !std::isnan(measure.value) &&
+         (validation == nullptr || validation->IsValid(measure.tags));
+}
+
+// the common tags that every measurement in the batch has. They are sent once
+// in the top level tags section instead of with each metric. Rollups can drop
+// common tags, so the ones that are missing from any measurement are kept in
+// the metrics that have them
+static Tags BatchTags(const Tags& common_tags, const MeasurementsIter& first,
+                      const MeasurementsIter& last) {
+  std::vector<bool> shared(common_tags.size(), true);
+  for (auto it = first; it < last; ++it) {
+    if (std::isnan(it->value)) {
+      continue;
+    }
+    size_t i = 0;
+    for (const auto& tag : common_tags) {
+      if (shared[i]) {
+        auto found = it->tags.find(tag.first);
+        shared[i] = found != it->tags.end() && found->second == tag.second;
+      }
+      ++i;
+    }
+  }
+  Tags res;
+  size_t i = 0;
+  for (const auto& tag : common_tags) {
+    if (shared[i++]) {
+      res.add(tag.first, tag.second);
+    }
+  }
+  return res;
+}
+
+// call f for each tag of a measurement that is not one of the batch tags.
+// Measurements that are sent have all of them, and tags are sorted by key
+template <typename F>
+static void ForEachOwnTag(const Tags& tags, const Tags& batch_tags, F f) {
+  auto shared = batch_tags.begin();
+  for (const auto& tag : tags) {
+    if (shared != batch_tags.end() && shared->first == tag.first) {
+      ++shared;
+    } else {
+      f(tag);
+    }
+  }
+}
+
+// sanitized tags never need escaping
+static void WriteTag(util::JsonWriter* writer, const Tags::Entry& tag) {
+  writer->SafeString(util::ToValidCharset(tag.first).get());
+  writer->SafeString(util::EncodeValueForKey(tag.second, tag.first).get());
+}
+
+std::string MeasurementsToJson(int64_t now_millis, const Tags& common_tags,
+                               const MeasurementsIter& first,
+                               const MeasurementsIter& last,
+                               validation::ValidationCache* validation,
+                               int64_t* metrics_added) {
+  int64_t added = 0;
+  auto batch_tags = BatchTags(common_tags, first, last);
+  util::JsonWriter writer;
+  writer.StartObject();
+  writer.SafeString("tags");
+  writer.StartObject();
+  for (const auto& tag : batch_tags) {
+    WriteTag(&writer, tag);
+  }
+  writer.EndObject();
+  writer.SafeString("metrics");
+  writer.StartArray();
+  for (auto it = first; it < last; it++) {
+    const auto& measure = *it;
+    if (!ShouldSend(measure, validation)) {
+      continue;
+    }
+    writer.StartObject();
+    writer.SafeString("tags");
+    writer.StartObject();
+    ForEachOwnTag(measure.tags, batch_tags, [&writer](const Tags::Entry& tag) {
+      WriteTag(&writer, tag);
+    });
+    writer.EndObject();
+    ++added;
+
+    writer.SafeString("start");
+    writer.Int64(now_millis);
+    writer.SafeString("value");
+    writer.Double(measure.value);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  *metrics_added = added;
+  return writer.Result();
+}
+
+static constexpr char kBinaryMagic[] = {'A', 'T', 'L'};
+static constexpr uint8_t kBinaryVersion = 1;
+
+namespace {
+
+class BinaryWriter {
+ public:
+  BinaryWriter() {
+    buf_.reserve(4096);
+    // sanitized strings are interned, so they can be looked up by address.
+    // They are not counted, so the writer must not outlive the measurements
+    indexes_.reserve(1024);
+  }
+
+  void Varint(uint64_t n) {
+    while (n >= 0x80) {
+      buf_ += static_cast<char>((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+    buf_ += static_cast<char>(n);
+  }
+
+  void Fixed(uint64_t n, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      buf_ += static_cast<char>(n >> (8 * i));
+    }
+  }
+
+  void Double(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof bits);
+    Fixed(bits, sizeof bits);
+  }
+
+  void String(util::StrRef ref) {
+    auto inserted = indexes_.emplace(ref.get(), indexes_.size());
+    if (!inserted.second) {
+      Varint(inserted.first->second + 1);
+      return;
+    }
+    auto size = strlen(ref.get());
+    Varint(0);
+    Varint(size);
+    buf_.append(ref.get(), size);
+  }
+
+  void Tag(const Tags::Entry& tag) {
+    String(util::ToValidCharset(tag.first));
+    String(util::EncodeValueForKey(tag.second, tag.first));
+  }
+
+  void Raw(const char* data, size_t size) { buf_.append(data, size); }
+
+  size_t Position() const noexcept { return buf_.size(); }
+
+  void PatchFixed(size_t pos, uint64_t n, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      buf_[pos + i] = static_cast<char>(n >> (8 * i));
+    }
+  }
+
+  const std::string& Result() const noexcept { return buf_; }
+
+ private:
+  std::string buf_;
+  std::unordered_map<const char*, uint64_t> indexes_;
+};
+
+}  // namespace
+
+std::string MeasurementsToBinary(int64_t now_millis, const Tags& common_tags,
+                                 const MeasurementsIter& first,
+                                 const MeasurementsIter& last,
+                                 validation::ValidationCache* validation,
+                                 int64_t* metrics_added) {
+  auto batch_tags = BatchTags(common_tags, first, last);
+  BinaryWriter writer;
+  writer.Raw(kBinaryMagic, sizeof kBinaryMagic);
+  writer.Fixed(kBinaryVersion, 1);
+  writer.Varint(static_cast<uint64_t>(now_millis));
+  writer.Varint(batch_tags.size());
+  for (const auto& tag : batch_tags) {
+    writer.Tag(tag);
+  }
+  // the count is only known at the end
+  auto count_pos = writer.Position();
+  writer.Fixed(0, 4);
+
+  int64_t added = 0;
+  for (auto it = first; it < last; it++) {
+    const auto& measure = *it;
+    if (!ShouldSend(measure, validation)) {
+      continue;
+    }
+    writer.Varint(measure.tags.size() - batch_tags.size());
+    ForEachOwnTag(measure.tags, batch_tags,
+                  [&writer](const Tags::Entry& tag) { writer.Tag(tag); });
+    writer.Double(measure.value);
+    ++added;
+  }
+  writer.PatchFixed(count_pos, static_cast<uint64_t>(added), 4);
+
+  *metrics_added = added;
+  return writer.Result();
+}
+
+namespace {
+
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size) noexcept
+      : cur_(reinterpret_cast<const uint8_t*>(data)), end_(cur_ + size) {}
+
+  bool Varint(uint64_t* n) noexcept {
+    uint64_t res = 0;
+    for (auto shift = 0; shift < 64; shift += 7) {
+      if (cur_ == end_) {
+        return false;
+      }
+      auto b = *cur_++;
+      res |= static_cast<uint64_t>(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) {
+        *n = res;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Fixed(uint64_t* n, size_t size) noexcept {
+    if (static_cast<size_t>(end_ - cur_) < size) {
+      return false;
+    }
+    uint64_t res = 0;
+    for (size_t i = 0; i < size; ++i) {
+      res |= static_cast<uint64_t>(*cur_++) << (8 * i);
+    }
+    *n = res;
+    return true;
+  }
+
+  bool Double(double* d) noexcept {
+    uint64_t bits;
+    if (!Fixed(&bits, sizeof bits)) {
+      return false;
+    }
+    memcpy(d, &bits, sizeof bits);
+    return true;
+  }
+
+  bool String(rapidjson::Value* value,
+              rapidjson::Document::AllocatorType& alloc) {
+    uint64_t n;
+    if (!Varint(&n)) {
+      return false;
+    }
+    if (n > 0) {
+      if (n > strings_.size()) {
+        return false;
+      }
+      const auto& s = strings_[n - 1];
+      value->SetString(s.first, static_cast<rapidjson::SizeType>(s.second),
+                       alloc);
+      return true;
+    }
+    uint64_t size;
+    if (!Varint(&size) || size > static_cast<uint64_t>(end_ - cur_)) {
+      return false;
+    }
+    auto s = reinterpret_cast<const char*>(cur_);
+    cur_ += size;
+    strings_.emplace_back(s, static_cast<size_t>(size));
+    value->SetString(s, static_cast<rapidjson::SizeType>(size), alloc);
+    return true;
+  }
+
+  bool Tags(rapidjson::Value* tags,
+            rapidjson::Document::AllocatorType& alloc) {
+    uint64_t n;
+    if (!Varint(&n)) {
+      return false;
+    }
+    tags->SetObject();
+    for (uint64_t i = 0; i < n; ++i) {
+      rapidjson::Value k;
+      rapidjson::Value v;
+      if (!String(&k, alloc) || !String(&v, alloc)) {
+        return false;
+      }
+      tags->AddMember(k, v, alloc);
+    }
+    return true;
+  }
+
+  bool Magic(const char* magic, size_t size) noexcept {
+    if (static_cast<size_t>(end_ - cur_) < size ||
+        memcmp(cur_, magic, size) != 0) {
+      return false;
+    }
+    cur_ += size;
+    return true;
+  }
+
+  bool AtEnd() const noexcept { return cur_ == end_; }
+
+ private:
+  const uint8_t* cur_;
+  const uint8_t* end_;
+  std::vector<std::pair<const char*, size_t>> strings_;
+};
+
+}  // namespace
+
+bool DecodeBinaryPayload(const char* data, size_t size,
+                         rapidjson::Document* payload) {
+  using rapidjson::Value;
+  BinaryReader reader{data, size};
+  auto& alloc = payload->GetAllocator();
+  uint64_t version, start, count;
+  Value common;
+  if (!reader.Magic(kBinaryMagic, sizeof kBinaryMagic) ||
+      !reader.Fixed(&version, 1) || version != kBinaryVersion ||
+      !reader.Varint(&start) || !reader.Tags(&common, alloc) ||
+      !reader.Fixed(&count, 4)) {
+    return false;
+  }
+
+  Value metrics{rapidjson::kArrayType};
+  for (uint64_t i = 0; i < count; ++i) {
+    Value tags;
+    double value;
+    if (!reader.Tags(&tags, alloc) || !reader.Double(&value)) {
+      return false;
+    }
+    Value metric{rapidjson::kObjectType};
+    metric.AddMember("tags", tags, alloc);
+    metric.AddMember("start", static_cast<int64_t>(start), alloc);
+    metric.AddMember("value", value, alloc);
+    metrics.PushBack(metric, alloc);
+  }
+  if (!reader.AtEnd()) {
+    return false;
+  }
+
+  payload->SetObject();
+  payload->AddMember("tags", common, alloc);
+  payload->AddMember("metrics", metrics, alloc);
+  return true;
+}
+
+namespace {
+
+class JsonEncoder : public PayloadEncoder {
+ public:
+  const char* ContentType() const noexcept override {
+    return "Content-Type: application/json";
+  }
+
+  const char* Extension() const noexcept override { return ".json"; }
+
+  std::string Encode(int64_t now_millis, const Tags& common_tags,
+                     const MeasurementsIter& first,
+                     const MeasurementsIter& last,
+                     validation::ValidationCache* validation,
+                     int64_t* metrics_added) const override {
+    return MeasurementsToJson(now_millis, common_tags, first, last, validation,
+                              metrics_added);
+  }
+};
+
+class BinaryEncoder : public PayloadEncoder {
+ public:
+  const char* ContentType() const noexcept override {
+    return "Content-Type: application/x-atlas-binary";
+  }
+
+  const char* Extension() const noexcept override { return ".bin"; }
+
+  std::string Encode(int64_t now_millis, const Tags& common_tags,
+                     const MeasurementsIter& first,
+                     const MeasurementsIter& last,
+                     validation::ValidationCache* validation,
+                     int64_t* metrics_added) const override {
+    return MeasurementsToBinary(now_millis, common_tags, first, last,
+                                validation, metrics_added);
+  }
+};
+
+}  // namespace
+
+const PayloadEncoder& EncoderFor(util::PayloadFormat format) noexcept {
+  static const JsonEncoder json_encoder;
+  static const BinaryEncoder binary_encoder;
+  switch (format) {
+    case util::PayloadFormat::Binary:
+      return binary_encoder;
+    case util::PayloadFormat::Json:
+      break;
+  }
+  return json_encoder;
+}
+
+}  // namespace meter
+}  // namespace atlas
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../interpreter/tags_value.h"
+#include "../util/config.h"
+#include "validation.h"
+#include <rapidjson/document.h>
+#include <string>
+
+namespace atlas {
+namespace meter {
+
+using MeasurementsIter = interpreter::TagsValuePairs::const_iterator;
+
+/// Encodes batches of measurements for the main publish cluster. Measurements
+/// with a NaN value or with tags that fail validation are skipped, and
+/// metrics_added is set to the number of measurements that were encoded.
+/// A null validation cache skips validation. The common tags that every
+/// measurement has are sent once in the payload's tags section
+class PayloadEncoder {
+ public:
+  virtual ~PayloadEncoder() = default;
+
+  /// header to post the payload with
+  virtual const char* ContentType() const noexcept = 0;
+
+  /// extension for payloads dumped to disk
+  virtual const char* Extension() const noexcept = 0;
+
+  virtual std::string Encode(int64_t now_millis, const Tags& common_tags,
+                             const MeasurementsIter& first,
+                             const MeasurementsIter& last,
+                             validation::ValidationCache* validation,
+                             int64_t* metrics_added) const = 0;
+};
+
+/// The encoder for the given publish format. Encoders are stateless and live
+/// for the life of the program
+const PayloadEncoder& EncoderFor(util::PayloadFormat format) noexcept;
+
+/// The JSON payload expected by the publish cluster
+std::string MeasurementsToJson(int64_t now_millis, const Tags& common_tags,
+                               const MeasurementsIter& first,
+                               const MeasurementsIter& last,
+                               validation::ValidationCache* validation,
+                               int64_t* metrics_added);
+
+/// Binary payloads are a compact alternative to JSON. Strings are dictionary
+/// encoded per payload, so tags repeated across metrics are sent once:
+///
+///   payload := "ATL" version:u8 start:varint common:tags count:u32 metric*
+///   tags    := n:varint (key:str value:str){n}
+///   metric  := tags value:f64
+///   str     := 0 size:varint byte{size}  -- new string, gets the next index
+///            | index + 1:varint          -- a string seen before
+///
+/// Varints are unsigned LEB128, and fixed size numbers are little endian
+std::string MeasurementsToBinary(int64_t now_millis, const Tags& common_tags,
+                                 const MeasurementsIter& first,
+                                 const MeasurementsIter& last,
+                                 validation::ValidationCache* validation,
+                                 int64_t* metrics_added);
+
+/// Decode a binary payload into the equivalent of the JSON payload. Returns
+/// false if the payload is malformed
+bool DecodeBinaryPayload(const char* data, size_t size,
+                         rapidjson::Document* payload);
+
+}  // namespace meter
+}  // namespace atlas
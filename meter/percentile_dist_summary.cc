@@ -33,7 +33,7 @@ std::shared_ptr<Counter> PercentileDistributionSummary::CounterFor(
   auto& c = counters_.at(i);
   if (!c) {
     c = registry_->counter(
-        id_->WithTag(statistic::percentile)->WithTag(PercentileTag(i)));
+        id_->WithTags({statistic::percentile, PercentileTag(i)}));
     counters_.at(i) = c;
   }
   return c;
@@ -31,7 +31,7 @@ std::shared_ptr<Counter> PercentileTimer::CounterFor(size_t i) const noexcept {
   auto& c = counters_.at(i);
   if (!c) {
     c = registry_->counter(
-        id_->WithTag(statistic::percentile)->WithTag(PercentileTag(i)));
+        id_->WithTags({statistic::percentile, PercentileTag(i)}));
     counters_.at(i) = c;
   }
   return c;
@@ -0,0 +1,241 @@
+#include "retry_queue.h"
+#include "../util/http.h"
+#include "../util/logger.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace atlas {
+namespace meter {
+
+using util::Logger;
+
+static constexpr int64_t kInitialBackoffMillis = 1000;
+static constexpr int64_t kMaxBackoffMillis = 16000;
+
+// spilled batches are stored as: num_metrics:i64 created_millis:i64
+// content_type_size:u32 content_type payload, in host byte order
+static constexpr size_t kSpillHeaderSize = 8 + 8 + 4;
+
+constexpr size_t RetryQueue::kMaxBatches;
+constexpr int64_t RetryQueue::kRetryWindowMillis;
+constexpr int64_t RetryQueue::kMaxSpillAgeMillis;
+constexpr size_t RetryQueue::kMaxReplaysPerRun;
+constexpr int RetryQueue::kMaxReplayAttempts;
+
+RetryQueue::RetryQueue(std::unique_ptr<util::SpillRing> spill)
+    : spill_(std::move(spill)), rng_(std::random_device{}()) {}
+
+bool RetryQueue::ShouldRetry(int status) noexcept {
+  return status == util::http::kTransportError || status == 429 ||
+         status >= 500;
+}
+
+void RetryQueue::RecordStatus(int status) noexcept {
+  healthy_.store(status == 200, std::memory_order_relaxed);
+}
+
+// the backoff doubles with each attempt, and we wait between half of it and
+// all of it so instances that failed together do not retry together
+int64_t RetryQueue::NextAttempt(int attempts, int64_t now_millis) {
+  auto backoff = std::min(kInitialBackoffMillis << std::min(attempts - 1, 16),
+                          kMaxBackoffMillis);
+  std::uniform_int_distribution<int64_t> jitter{backoff / 2, backoff};
+  return now_millis + jitter(rng_);
+}
+
+RetryQueue::Result RetryQueue::Add(std::string content_type,
+                                   std::shared_ptr<const std::string> payload,
+                                   int64_t num_metrics, int64_t now_millis) {
+  Result result;
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (batches_.size() >= kMaxBatches) {
+    Spill(batches_.front(), &result);
+    batches_.pop_front();
+  }
+  batches_.push_back(Batch{std::move(content_type), std::move(payload),
+                           num_metrics, now_millis, 1,
+                           NextAttempt(1, now_millis)});
+  return result;
+}
+
+void RetryQueue::Spill(const Batch& batch, Result* result) {
+  auto record_size =
+      kSpillHeaderSize + batch.content_type.size() + batch.payload->size();
+  if (!spill_ || !spill_->Fits(record_size)) {
+    Logger()->warn("Dropping a batch of {} metrics after {} attempts",
+                   batch.num_metrics, batch.attempts);
+    result->dropped += batch.num_metrics;
+    return;
+  }
+
+  // make room by dropping the oldest spilled batches
+  std::string oldest;
+  uint64_t seq;
+  while (!spill_->HasRoom(record_size) &&
+         spill_->Front(&oldest, &seq, kSpillHeaderSize)) {
+    int64_t num_metrics = 0;
+    if (oldest.size() >= kSpillHeaderSize) {
+      memcpy(&num_metrics, oldest.data(), sizeof num_metrics);
+    }
+    result->dropped += num_metrics;
+    spill_->Pop(seq);
+  }
+
+  std::string record;
+  record.reserve(record_size);
+  auto ct_size = static_cast<uint32_t>(batch.content_type.size());
+  record.append(reinterpret_cast<const char*>(&batch.num_metrics), 8);
+  record.append(reinterpret_cast<const char*>(&batch.created_millis), 8);
+  record.append(reinterpret_cast<const char*>(&ct_size), 4);
+  record += batch.content_type;
+  record += *batch.payload;
+  if (!spill_->Push(record.data(), record.size())) {
+    result->dropped += batch.num_metrics;
+  }
+}
+
+RetryQueue::Result RetryQueue::Run(const Sender& sender, int64_t now_millis) {
+  Result result;
+  std::vector<Batch> due;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = batches_.begin();
+    while (it != batches_.end()) {
+      if (now_millis - it->created_millis >= kRetryWindowMillis) {
+        Spill(*it, &result);
+        it = batches_.erase(it);
+      } else if (it->next_attempt_millis <= now_millis) {
+        due.push_back(std::move(*it));
+        it = batches_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // post without holding the lock, so new failures can be added meanwhile
+  for (auto& batch : due) {
+    auto status = sender(batch.content_type, *batch.payload);
+    RecordStatus(status);
+    if (status == 200) {
+      result.sent += batch.num_metrics;
+      continue;
+    }
+    if (!ShouldRetry(status)) {
+      result.dropped += batch.num_metrics;
+      continue;
+    }
+    ++batch.attempts;
+    std::lock_guard<std::mutex> guard(mutex_);
+    batch.next_attempt_millis = NextAttempt(batch.attempts, now_millis);
+    if (batches_.size() >= kMaxBatches) {
+      Spill(batch, &result);
+    } else {
+      batches_.push_back(std::move(batch));
+    }
+  }
+
+  Replay(sender, now_millis, &result);
+  return result;
+}
+
+void RetryQueue::Replay(const Sender& sender, int64_t now_millis,
+                        Result* result) {
+  std::string record;
+  uint64_t seq;
+  for (size_t i = 0; i < kMaxReplaysPerRun; ++i) {
+    if (!healthy_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!spill_ || !spill_->Front(&record, &seq)) {
+        return;
+      }
+    }
+
+    int64_t num_metrics = 0, created_millis = 0;
+    uint32_t ct_size = 0;
+    if (record.size() >= kSpillHeaderSize) {
+      memcpy(&num_metrics, record.data(), 8);
+      memcpy(&created_millis, record.data() + 8, 8);
+      memcpy(&ct_size, record.data() + 16, 4);
+    }
+    if (record.size() < kSpillHeaderSize + ct_size ||
+        now_millis - created_millis > kMaxSpillAgeMillis) {
+      result->dropped += num_metrics;
+    } else {
+      auto content_type = record.substr(kSpillHeaderSize, ct_size);
+      auto payload = record.substr(kSpillHeaderSize + ct_size);
+      auto status = sender(content_type, payload);
+      RecordStatus(status);
+      if (status == 200) {
+        result->sent += num_metrics;
+      } else if (ShouldRetry(status) && !GiveUpReplaying(seq)) {
+        return;
+      } else {
+        Logger()->warn("Dropping a spilled batch of {} metrics: {}",
+                       num_metrics, status);
+        result->dropped += num_metrics;
+      }
+    }
+    std::lock_guard<std::mutex> guard(mutex_);
+    spill_->Pop(seq);
+  }
+}
+
+// only the replay thread looks at the failures
+bool RetryQueue::GiveUpReplaying(uint64_t seq) noexcept {
+  if (seq != failed_seq_) {
+    failed_seq_ = seq;
+    failed_replays_ = 0;
+  }
+  return ++failed_replays_ >= kMaxReplayAttempts;
+}
+
+RetryQueue::Result RetryQueue::SpillAll() {
+  Result result;
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (const auto& batch : batches_) {
+    Spill(batch, &result);
+  }
+  batches_.clear();
+  return result;
+}
+
+size_t RetryQueue::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return batches_.size();
+}
+
+size_t RetryQueue::spilled() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return spill_ ? spill_->size() : 0;
+}
+
+int64_t RetryQueue::OldestMillis() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  int64_t oldest = 0;
+  for (const auto& batch : batches_) {
+    if (oldest == 0 || batch.created_millis < oldest) {
+      oldest = batch.created_millis;
+    }
+  }
+  return oldest;
+}
+
+int64_t RetryQueue::OldestSpilledMillis() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::string record;
+  uint64_t seq;
+  int64_t created_millis = 0;
+  if (spill_ && spill_->Front(&record, &seq, kSpillHeaderSize) &&
+      record.size() >= kSpillHeaderSize) {
+    memcpy(&created_millis, record.data() + 8, 8);
+  }
+  return created_millis;
+}
+
+}  // namespace meter
+}  // namespace atlas
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../util/spill_ring.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace atlas {
+namespace meter {
+
+/// Keeps the batches that could not be sent to the main publish cluster and
+/// retries them with jittered exponential backoff. Batches still failing at
+/// the end of the retry window, or that do not fit in memory, are spilled to
+/// a ring file when one is given, and replayed once sends succeed again
+class RetryQueue {
+ public:
+  /// posts a payload, returning the http status code
+  using Sender = std::function<int(const std::string& content_type,
+                                   const std::string& payload)>;
+
+  /// number of metrics in the batches that were sent, or given up on
+  struct Result {
+    int64_t sent = 0;
+    int64_t dropped = 0;
+  };
+
+  static constexpr size_t kMaxBatches = 8;
+  static constexpr int64_t kRetryWindowMillis = 45000;
+  // the publish cluster rejects data that is much older than this
+  static constexpr int64_t kMaxSpillAgeMillis = 3600 * 1000;
+  static constexpr size_t kMaxReplaysPerRun = 4;
+  // a spilled batch that keeps failing while other posts work is dropped, so
+  // it does not hold back the batches spilled after it
+  static constexpr int kMaxReplayAttempts = 5;
+
+  explicit RetryQueue(std::unique_ptr<util::SpillRing> spill = nullptr);
+
+  /// whether a failed post with the given status could work later: the
+  /// request could not be made, or the server is overloaded or failing
+  static bool ShouldRetry(int status) noexcept;
+
+  /// remember whether the last post worked, so spilled batches are only
+  /// replayed while the publish cluster is up
+  void RecordStatus(int status) noexcept;
+
+  /// queue a batch that failed for the first time. The payload is shared
+  /// with the caller, so it must not change afterwards
+  Result Add(std::string content_type,
+             std::shared_ptr<const std::string> payload, int64_t num_metrics,
+             int64_t now_millis);
+
+  /// Retry the batches that are due, spill the ones that ran out of time and
+  /// replay spilled batches. Must not run concurrently with itself
+  Result Run(const Sender& sender, int64_t now_millis);
+
+  /// spill every queued batch, for example before shutting down
+  Result SpillAll();
+
+  size_t size() const;
+  size_t spilled() const;
+
+  /// wall clock time when the oldest queued batch first failed, or 0
+  int64_t OldestMillis() const;
+  int64_t OldestSpilledMillis() const;
+
+ private:
+  struct Batch {
+    std::string content_type;
+    std::shared_ptr<const std::string> payload;
+    int64_t num_metrics;
+    int64_t created_millis;
+    int attempts;
+    int64_t next_attempt_millis;
+  };
+
+  mutable std::mutex mutex_;
+  std::deque<Batch> batches_;
+  std::unique_ptr<util::SpillRing> spill_;
+  std::mt19937_64 rng_;
+  std::atomic<bool> healthy_{false};
+  // the spilled batch at the head of the ring that failed to replay, and how
+  // many times it did
+  uint64_t failed_seq_ = 0;
+  int failed_replays_ = 0;
+
+  int64_t NextAttempt(int attempts, int64_t now_millis);
+  void Spill(const Batch& batch, Result* result);
+  void Replay(const Sender& sender, int64_t now_millis, Result* result);
+  bool GiveUpReplaying(uint64_t seq) noexcept;
+};
+
+}  // namespace meter
+}  // namespace atlas
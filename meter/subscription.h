@@ -22,14 +22,67 @@ inline bool operator==(const Subscription& lhs, const Subscription& rhs) {
 
 using DataExpressionResults = std::vector<interpreter::TagsValuePairs>;
 
+/// A value computed for a subscription, referring to the id and tags held
+/// by the SubscriptionResults it belongs to
 struct SubscriptionMetric {
-  const std::string id;
-  const Tags tags;
-  const double value;
+  size_t subscription;
+  const Tags& tags;
+  double value;
 };
 
-using SubscriptionResults = std::vector<SubscriptionMetric>;
+using SubscriptionMetrics = std::vector<SubscriptionMetric>;
+
+/// The values computed for the subscriptions sent at one interval. Ids are
+/// interned when subscriptions are refreshed, and the tags are the ones
+/// produced by evaluating each subscription, so building the metrics copies
+/// neither. The results hold a reference to each id, so ids of subscriptions
+/// removed while the results are being sent stay valid
+struct SubscriptionResults {
+  SubscriptionResults() = default;
+  SubscriptionResults(SubscriptionResults&&) = default;
+  SubscriptionResults& operator=(SubscriptionResults&& other) noexcept {
+    // other releases the ids we held
+    std::swap(ids, other.ids);
+    std::swap(values, other.values);
+    std::swap(metrics, other.metrics);
+    return *this;
+  }
+  // metrics refer to the tags in values
+  SubscriptionResults(const SubscriptionResults&) = delete;
+  SubscriptionResults& operator=(const SubscriptionResults&) = delete;
+  ~SubscriptionResults() {
+    for (auto id : ids) {
+      util::release_ref(id);
+    }
+  }
+
+  /// subscription ids, indexed by SubscriptionMetric::subscription
+  std::vector<util::StrRef> ids;
+  /// the results of each subscription, which own the tags
+  std::vector<interpreter::TagsValuePairs> values;
+  SubscriptionMetrics metrics;
+
+  /// add the values computed for the subscription with the given id, which
+  /// the caller must hold a reference to
+  void Add(util::StrRef id, interpreter::TagsValuePairs pairs) {
+    auto index = ids.size();
+    ids.push_back(util::acquire_ref(id));
+    values.push_back(std::move(pairs));
+    for (const auto& pair : values.back()) {
+      metrics.push_back(SubscriptionMetric{index, pair.tags, pair.value});
+    }
+  }
+};
 
 using Subscriptions = std::vector<Subscription>;
+
+/// How a new set of subscriptions differs from the current one. A
+/// subscription whose frequency or expression changed counts as removed and
+/// added
+struct SubscriptionsDiff {
+  size_t added;
+  size_t removed;
+  size_t unchanged;
+};
 }  // namespace meter
 }  // namespace atlas
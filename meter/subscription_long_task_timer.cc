@@ -7,7 +7,11 @@ namespace meter {
 
 SubscriptionLongTaskTimer::SubscriptionLongTaskTimer(IdPtr id,
                                                      const Clock& clock)
-    : Meter(id, clock), next_(0), tasks_(EXPECTED_TASKS) {}
+    : Meter(id, clock),
+      active_tasks_id_(id->WithTag(statistic::activeTasks)),
+      duration_id_(id->WithTag(statistic::duration)),
+      next_(0),
+      tasks_(EXPECTED_TASKS) {}
 
 int64_t SubscriptionLongTaskTimer::Start() {
   std::lock_guard<std::mutex> lock(tasks_mutex_);
@@ -57,8 +61,8 @@ Measurements SubscriptionLongTaskTimer::MeasuresForPoller(
   const auto duration_in_secs = Duration() / NANOS_IN_SECS;
   double active = ActiveTasks();
   return Measurements{
-      Measurement{id_->WithTag(statistic::activeTasks), now, active},
-      Measurement{id_->WithTag(statistic::duration), now, duration_in_secs}};
+      Measurement{active_tasks_id_, now, active},
+      Measurement{duration_id_, now, duration_in_secs}};
 }
 
 std::ostream& SubscriptionLongTaskTimer::Dump(std::ostream& os) const {
@@ -30,6 +30,9 @@ class SubscriptionLongTaskTimer : public Meter, public LongTaskTimer {
 
  private:
   static const int EXPECTED_TASKS = 8;
+  // ids for the measurements, derived once
+  const IdPtr active_tasks_id_;
+  const IdPtr duration_id_;
   std::atomic<int64_t> next_;
   mutable std::mutex tasks_mutex_;
   std::unordered_map<int64_t, int64_t> tasks_;
@@ -1,25 +1,82 @@
 #include "subscription_manager.h"
 #include "../atlas_client.h"
 #include "../util/http.h"
-#include "../util/json.h"
+#include "../util/json_writer.h"
 #include "../util/logger.h"
 #include "../util/string_pool.h"
 #include "../util/strings.h"
+#include "payload_encoder.h"
+#include "percentile_timer.h"
+#include "subscriptions_parser.h"
 #include "validation.h"
 #include <chrono>
 #include <cstdlib>
 #include <curl/curl.h>
 #include <fstream>
 #include <random>
-#include <sstream>
-#include <zlib.h>
+#include <unordered_map>
 
 namespace atlas {
 namespace meter {
 
+static constexpr size_t kSchedulerWorkers = 4;
+static constexpr std::chrono::seconds kRetryPeriod{1};
+// limits for the payloads dumped for debugging. Files are kept per prefix
+static constexpr size_t kMaxQueuedDumpBytes = 64 << 20;
+static constexpr size_t kMaxDumpFiles = 100;
+static constexpr size_t kMaxDumpFileBytes = 256 << 20;
+static constexpr const char* kJsonType = "Content-Type: application/json";
+
+// lateness of each scheduled task, as a percentile timer
+static void RecordLag(const std::string& task,
+                      util::Scheduler::Clock::duration lag) {
+  static auto lag_id =
+      atlas_registry.CreateId("atlas.client.schedulerLag", kEmptyTags);
+  static std::mutex timers_mutex;
+  static std::unordered_map<std::string, std::shared_ptr<PercentileTimer>>
+      timers;
+
+  std::shared_ptr<PercentileTimer> timer;
+  {
+    std::lock_guard<std::mutex> guard(timers_mutex);
+    auto& t = timers[task];
+    if (!t) {
+      t = std::make_shared<PercentileTimer>(
+          &atlas_registry, lag_id->WithTag(Tag::of("task", task.c_str())));
+    }
+    timer = t;
+  }
+  timer->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(lag));
+}
+
+// per-instance jitter in [0, 1) so that not every instance publishes at the
+// same time
+static double GetJitter() {
+  std::random_device rd;
+  return std::uniform_real_distribution<double>(0.0, 1.0)(rd);
+}
+
+// the ring file for batches that could not be published, if configured. It
+// is only opened once, so changes to the file in the config need a restart
+static std::unique_ptr<util::SpillRing> OpenSpillRing(
+    const util::Config& config) {
+  const auto& file_name = config.SpillFile();
+  if (file_name.empty() || config.SpillMegabytes() <= 0) {
+    return nullptr;
+  }
+  return util::SpillRing::Open(
+      file_name, static_cast<size_t>(config.SpillMegabytes()) << 20);
+}
+
 SubscriptionManager::SubscriptionManager(
     const util::ConfigManager& config_manager, SubscriptionRegistry& registry)
-    : config_manager_(config_manager), registry_(registry) {}
+    : config_manager_(config_manager),
+      registry_(registry),
+      jitter_(GetJitter()),
+      retry_queue_(OpenSpillRing(*config_manager.GetConfig())),
+      dump_writer_("/tmp", kMaxQueuedDumpBytes, kMaxDumpFiles,
+                   kMaxDumpFileBytes),
+      scheduler_(kSchedulerWorkers, RecordLag) {}
 
 using util::kMainFrequencyMillis;
 using util::Logger;
@@ -29,35 +86,26 @@ using std::chrono::system_clock;
 using std::chrono::duration_cast;
 using std::chrono::milliseconds;
 
-static constexpr int64_t kMinWaitMillis = 1;
+// run senders at most a third of the way into a step, so the step that was
+// just completed gets published
+milliseconds SubscriptionManager::StepOffset(int64_t step_millis) const
+    noexcept {
+  return milliseconds(static_cast<int64_t>(jitter_ * step_millis / 3));
+}
 
-void SubscriptionManager::MainSender(
-    std::chrono::seconds initial_delay) noexcept {
-  Logger()->info("Waiting for {} seconds to send the first batch to main.",
-                 initial_delay.count());
-  std::this_thread::sleep_for(initial_delay);
-  while (should_run_) {
-    auto start = system_clock::now();
-    const auto& config = config_manager_.GetConfig();
-    if (config->IsMainEnabled()) {
-      Logger()->debug("SendToMain()");
-      try {
-        UpdateMetrics();
-        SendToMain();
-      } catch (const std::exception& e) {
-        Logger()->error("Error sending to main publish cluster: {}", e.what());
-      }
-    } else {
-      Logger()->info(
-          "Not sending anything to the main publish cluster (disabled)");
+void SubscriptionManager::MainSender() noexcept {
+  const auto& config = config_manager_.GetConfig();
+  if (config->IsMainEnabled()) {
+    Logger()->debug("SendToMain()");
+    try {
+      UpdateMetrics();
+      SendToMain();
+    } catch (const std::exception& e) {
+      Logger()->error("Error sending to main publish cluster: {}", e.what());
     }
-    auto elapsed_millis =
-        duration_cast<milliseconds>(system_clock::now() - start).count();
-    auto wait_millis =
-        std::max(kMinWaitMillis, kMainFrequencyMillis - elapsed_millis);
-    Logger()->debug("Waiting {} millis until next main publish sender run",
-                    wait_millis);
-    std::this_thread::sleep_for(milliseconds(wait_millis));
+  } else {
+    Logger()->info(
+        "Not sending anything to the main publish cluster (disabled)");
   }
 }
 
@@ -70,101 +118,70 @@ static void updateAlertServer(const std::string& endpoint, int connect_timeout,
 }
 
 void SubscriptionManager::SubRefresher() noexcept {
-  static uint64_t refresher_runs = 0;
-
-  while (should_run_) {
-    try {
-      auto start = system_clock::now();
-      const auto& config = config_manager_.GetConfig();
-      auto subs_endpoint = config->SubsEndpoint();
-      if (config->AreSubsEnabled()) {
-        Logger()->info("Refreshing subscriptions from {}", subs_endpoint);
-        RefreshSubscriptions(subs_endpoint);
-      }
-      // HACK (temporary until lwc does alerts)
-      // notify alert server that we do not support on-instance alerts
-      if (config->ShouldNotifyAlertServer() && refresher_runs % 30 == 0) {
-        auto check_cluster_endpoint = config->CheckClusterEndpoint();
-        Logger()->debug(
-            "Notifying alert server about our lack of on-instance alerts "
-            "support {}",
-            check_cluster_endpoint);
-        updateAlertServer(check_cluster_endpoint, config->ConnectTimeout(),
-                          config->ReadTimeout());
-      }
-      ++refresher_runs;
-      auto end = system_clock::now();
-      auto elapsed_millis = duration_cast<milliseconds>(end - start).count();
-      auto refresh_millis = config->SubRefreshMillis();
-      auto wait_millis =
-          std::max(kMinWaitMillis, refresh_millis - elapsed_millis);
-      Logger()->debug("Waiting {}ms for next refresh subscription cycle",
-                      wait_millis);
-      std::this_thread::sleep_for(std::chrono::milliseconds(wait_millis));
-    } catch (std::exception& e) {
-      Logger()->info("Ignoring exception while refreshing configs: {}",
-                     e.what());
+  try {
+    const auto& config = config_manager_.GetConfig();
+    auto subs_endpoint = config->SubsEndpoint();
+    if (config->AreSubsEnabled()) {
+      Logger()->info("Refreshing subscriptions from {}", subs_endpoint);
+      RefreshSubscriptions(subs_endpoint);
+    }
+    // HACK (temporary until lwc does alerts)
+    // notify alert server that we do not support on-instance alerts
+    if (config->ShouldNotifyAlertServer() && refresher_runs_ % 30 == 0) {
+      auto check_cluster_endpoint = config->CheckClusterEndpoint();
+      Logger()->debug(
+          "Notifying alert server about our lack of on-instance alerts "
+          "support {}",
+          check_cluster_endpoint);
+      updateAlertServer(check_cluster_endpoint, config->ConnectTimeout(),
+                        config->ReadTimeout());
     }
+    ++refresher_runs_;
+  } catch (std::exception& e) {
+    Logger()->info("Ignoring exception while refreshing configs: {}",
+                   e.what());
   }
 }
 
 void SubscriptionManager::SubSender(int64_t millis) noexcept {
-  while (should_run_) {
-    auto start = system_clock::now();
-    try {
-      SendMetricsForInterval(millis);
-    } catch (std::exception& e) {
-      Logger()->info("Ignoring exception while sending metrics for {}ms: {}",
-                     millis, e.what());
-    }
-    auto end = system_clock::now();
-    auto elapsed_millis = duration_cast<milliseconds>(end - start).count();
-    auto delta = millis - elapsed_millis;
-    auto wait_millis = delta > 0 ? delta : 0;
-    Logger()->info("Waiting {}ms for next send cycle for {}ms interval",
-                   wait_millis, millis);
-    std::this_thread::sleep_for(milliseconds(wait_millis));
+  try {
+    SendMetricsForInterval(millis);
+  } catch (std::exception& e) {
+    Logger()->info("Ignoring exception while sending metrics for {}ms: {}",
+                   millis, e.what());
   }
 }
 
 // non-static for testing
-rapidjson::Document SubResultsToJson(
-    int64_t now_millis, const SubscriptionResults::const_iterator& first,
-    const SubscriptionResults::const_iterator& last) {
-  using rapidjson::Document;
-  using rapidjson::kArrayType;
-  using rapidjson::kObjectType;
-  using rapidjson::SizeType;
-  using rapidjson::Value;
-
-  Document ret{kObjectType};
-  auto& alloc = ret.GetAllocator();
-  ret.AddMember("timestamp", now_millis, alloc);
-  Value metrics{kArrayType};
-
+std::string SubResultsToJson(int64_t now_millis,
+                             const SubscriptionResults& results,
+                             const SubscriptionMetrics::const_iterator& first,
+                             const SubscriptionMetrics::const_iterator& last) {
+  util::JsonWriter writer;
+  writer.StartObject();
+  writer.SafeString("timestamp");
+  writer.Int64(now_millis);
+  writer.SafeString("metrics");
+  writer.StartArray();
   for (auto it = first; it != last; ++it) {
     const auto& subscriptionResult = *it;
-    Value sub{kObjectType};
-    const auto& id = subscriptionResult.id;
-    sub.AddMember("id",
-                  Value().SetString(id.c_str(),
-                                    static_cast<SizeType>(id.length()), alloc),
-                  alloc);
-    Value tags{kObjectType};
+    writer.StartObject();
+    writer.SafeString("id");
+    writer.String(results.ids[subscriptionResult.subscription].get());
+    writer.SafeString("tags");
+    writer.StartObject();
     for (const auto& kv : subscriptionResult.tags) {
-      const auto* key = kv.first.get();
-      Value k(key, static_cast<SizeType>(strlen(key)), alloc);
-
-      const auto* val = kv.second.get();
-      Value v(val, static_cast<SizeType>(strlen(val)), alloc);
-      tags.AddMember(k, v, alloc);
+      writer.String(kv.first.get());
+      writer.String(kv.second.get());
     }
-    sub.AddMember("tags", tags, alloc);
-    sub.AddMember("value", subscriptionResult.value, alloc);
-    metrics.PushBack(sub, alloc);
+    writer.EndObject();
+    writer.SafeString("value");
+    writer.Double(subscriptionResult.value);
+    writer.EndObject();
   }
-  ret.AddMember("metrics", metrics, alloc);
-  return ret;
+  writer.EndArray();
+  writer.EndObject();
+  return writer.Result();
 }
 
 // Get the set of intervals in milliseconds from a list of subscriptions
@@ -178,27 +195,13 @@ std::set<int64_t> GetIntervals(const Subscriptions* subs) {
 }
 
 Subscriptions* ParseSubscriptions(const std::string& subs_str) {
-  using rapidjson::Document;
-  using rapidjson::kParseCommentsFlag;
-  using rapidjson::kParseNanAndInfFlag;
-
-  Document document;
-  document.Parse<kParseCommentsFlag | kParseNanAndInfFlag>(subs_str.c_str());
-  auto subs = new Subscriptions;
-  if (document.IsObject()) {
-    auto expressions = document["expressions"].GetArray();
-    for (auto& e : expressions) {
-      if (e.IsObject()) {
-        auto expr = e.GetObject();
-        subs->push_back(Subscription{expr["id"].GetString(),
-                                     expr["frequency"].GetInt64(),
-                                     expr["expression"].GetString()});
-      }
-    }
+  SubscriptionsParser parser;
+  if (parser.Feed(subs_str.c_str(), subs_str.length()) && parser.Finish()) {
+    return parser.Release().release();
   }
-
-  return subs;
+  return new Subscriptions;
 }
+
 void SubscriptionManager::RefreshSubscriptions(
     const std::string& subs_endpoint) {
   static auto timer_refresh_subs =
@@ -210,34 +213,40 @@ void SubscriptionManager::RefreshSubscriptions(
       atlas_registry.counter(atlas_registry.CreateId(
           "atlas.client.refreshSubsErrors", Tags{{"error", "http"}}));
   util::http http_client;
-  std::string subs_str;
+  SubscriptionsParser parser;
   auto logger = Logger();
 
   auto cfg = config_manager_.GetConfig();
   auto connect_timeout = cfg->ConnectTimeout();
   auto read_timeout = cfg->ReadTimeout();
   auto start = atlas_registry.clock().MonotonicTime();
-  auto http_res = http_client.conditional_get(
-      subs_endpoint, current_etag, connect_timeout, read_timeout, subs_str);
+  // parse the subscriptions as they arrive
+  auto http_res = http_client.conditional_stream(
+      subs_endpoint, current_etag, connect_timeout, read_timeout,
+      [&parser](const char* data, size_t size) { parser.Feed(data, size); });
   timer_refresh_subs->Record(atlas_registry.clock().MonotonicTime() - start);
-  if (http_res == 200) {
-    auto subscriptions = ParseSubscriptions(subs_str);
-    auto old_subs = subscriptions_.exchange(subscriptions);
+  if (http_res == 200 && !parser.Finish()) {
+    logger->error("Unable to parse subscriptions from {}", subs_endpoint);
+    // make sure we get the subscriptions again on the next refresh
+    current_etag.clear();
+    refresh_parsing_errors->Increment();
+  } else if (http_res == 200) {
+    auto subscriptions = parser.Release();
     try {
-      const auto subs = subscriptions_.load(std::memory_order_relaxed);
-      registry_.update_subscriptions(subs);
-      auto new_intervals = GetIntervals(subs);
+      auto diff = registry_.update_subscriptions(subscriptions.get());
+      logger->info("Subscriptions: {} added, {} removed, {} unchanged",
+                   diff.added, diff.removed, diff.unchanged);
+      auto new_intervals = GetIntervals(subscriptions.get());
       for (auto i : new_intervals) {
-        if (sender_intervals_.find(i) == sender_intervals_.end()) {
+        if (sender_intervals_.insert(i).second) {
           logger->info("New sender for {} milliseconds detected. Scheduling",
                        i);
-          std::thread sub_sender_thread{&SubscriptionManager::SubSender, this,
-                                        i};
-          sub_sender_thread.detach();
+          scheduler_.ScheduleAligned("lwc-" + std::to_string(i),
+                                     StepOffset(i), milliseconds(i),
+                                     [this, i]() { SubSender(i); });
         }
       }
     } catch (...) {
-      delete old_subs;
       refresh_parsing_errors->Increment();
     }
   } else if (http_res == 304) {
@@ -248,77 +257,80 @@ void SubscriptionManager::RefreshSubscriptions(
   }
 }
 
+static const Tags& PublishCounterTags() {
+  const static Tags atlas_client_tags{
+      {intern_str("class"), intern_str("NetflixAtlasObserver")},
+      {intern_str("id"), intern_str("main-vip")}};
+  return atlas_client_tags;
+}
+
+// account for the metrics in batches that were sent or given up on after
+// being retried
+static void RecordRetryResult(const RetryQueue::Result& result) {
+  const auto& atlas_client_tags = PublishCounterTags();
+  static auto sent = atlas_registry.counter(
+      atlas_registry.CreateId("numMetricsSent", atlas_client_tags));
+  static auto dropped = atlas_registry.counter(
+      atlas_registry.CreateId("numMetricsDropped", atlas_client_tags)
+          ->WithTag(Tag::of("error", "retriesExhausted")));
+  if (result.sent > 0) {
+    sent->Add(result.sent);
+  }
+  if (result.dropped > 0) {
+    dropped->Add(result.dropped);
+  }
+}
+
 void SubscriptionManager::Stop(SystemClockWithOffset* clock) noexcept {
   if (should_run_) {
     should_run_ = false;
+    scheduler_.Stop();
     if (clock != nullptr) {
       Logger()->info("Advancing clock and flushing metrics");
       clock->SetOffset(59900);
       SendToMain();
     }
+    // keep what could not be sent for the next run
+    RecordRetryResult(retry_queue_.SpillAll());
   }
 }
 
-SubscriptionManager::~SubscriptionManager() {
-  delete subscriptions_.load();
-  if (should_run_) {
-    Stop();
-  }
-}
-
-static constexpr int kMaxSecsToStart = 20;
-static constexpr int kMainFrequencySecs = kMainFrequencyMillis / 1000;
-static std::chrono::seconds GetInitialDelay() {
-  using std::chrono::seconds;
-  std::random_device rd;
-  int rand_seconds = rd();
-  auto targetSecs = std::abs(rand_seconds % kMaxSecsToStart);
-  auto now = system_clock::to_time_t(system_clock::now());
-  auto offset = now % kMainFrequencySecs;
-  auto delay = targetSecs - offset;
-  return seconds(delay >= 0 ? delay : delay + kMainFrequencySecs);
-}
+SubscriptionManager::~SubscriptionManager() { Stop(); }
 
 void SubscriptionManager::Start() noexcept {
   should_run_ = true;
-  std::thread sub_refresher_thread(&SubscriptionManager::SubRefresher, this);
-  sub_refresher_thread.detach();
-
-  auto initialDelay = GetInitialDelay();
-  std::thread main_sender_thread(&SubscriptionManager::MainSender, this,
-                                 initialDelay);
-  main_sender_thread.detach();
+  auto refresh_millis = config_manager_.GetConfig()->SubRefreshMillis();
+  scheduler_.SchedulePeriodic("refresh", milliseconds(0),
+                              milliseconds(refresh_millis),
+                              [this]() { SubRefresher(); });
+
+  auto offset = StepOffset(kMainFrequencyMillis);
+  Logger()->info("Sending to main {}ms after the start of each step",
+                 offset.count());
+  scheduler_.ScheduleAligned("main", offset,
+                             milliseconds(kMainFrequencyMillis),
+                             [this]() { MainSender(); });
+  scheduler_.SchedulePeriodic("retry", kRetryPeriod, kRetryPeriod,
+                              [this]() { RetryFailedBatches(); });
+  scheduler_.Start();
 }
 
-static void DumpJson(const std::string& dir, const std::string& base_file_name,
-                     const rapidjson::Document& payload) {
-  auto millis = system_clock::now().time_since_epoch().count();
-  auto logger = Logger();
-  std::ostringstream os;
-  os << dir << "/" << base_file_name << millis << ".json.gz";
-  auto file_name = os.str();
-
-  // get a c string
-  rapidjson::StringBuffer buffer;
-  auto c_str = util::JsonGetString(buffer, payload);
-
-  auto fd = gzopen(file_name.c_str(), "wb");
-  if (fd != nullptr) {
-    gzbuffer(fd, 65536);
-    auto written = gzputs(fd, c_str);
-    if (written <= 0) {
-      logger->error("Unable to write compressed file {}", file_name);
-    }
-    gzclose(fd);
-  } else {
-    logger->error("Unable to open {}", file_name);
+// dumps are only for debugging, so they are dropped instead of slowing down
+// the senders when the disk cannot keep up
+static void DumpPayload(util::DumpWriter* dump_writer,
+                        const std::string& prefix, const char* extension,
+                        std::shared_ptr<const std::string> payload) {
+  static auto dropped = atlas_registry.counter("atlas.client.dumpsDropped");
+  if (!dump_writer->Dump(prefix, extension, std::move(payload))) {
+    dropped->Increment();
   }
 }
 
 static void SendBatchToLwc(const util::http& client, const util::Config& config,
-                           int64_t freq_millis,
-                           const SubscriptionResults::const_iterator& first,
-                           const SubscriptionResults::const_iterator& last) {
+                           util::DumpWriter* dump_writer, int64_t freq_millis,
+                           const SubscriptionResults& results,
+                           const SubscriptionMetrics::const_iterator& first,
+                           const SubscriptionMetrics::const_iterator& last) {
   static auto sendBatchLwcId =
       atlas_registry.CreateId("atlas.client.lwcBatch", kEmptyTags);
   static auto errorId =
@@ -329,13 +341,14 @@ static void SendBatchToLwc(const util::http& client, const util::Config& config,
   Tag freq_tag = Tag::of("freq", msecs_str);
   auto timer = atlas_registry.timer(sendBatchLwcId->WithTag(freq_tag));
 
-  auto metrics = SubResultsToJson(clock.WallTime(), first, last);
+  auto metrics = std::make_shared<const std::string>(
+      SubResultsToJson(clock.WallTime(), results, first, last));
   if (config.ShouldDumpSubs()) {
-    std::string file_name{"lwc_"};
-    DumpJson("/tmp", file_name + msecs_str + "_", metrics);
+    DumpPayload(dump_writer, "lwc_" + msecs_str + "_", ".json", metrics);
   }
   auto res = client.post(config.EvalEndpoint(), config.ConnectTimeout(),
-                         config.ReadTimeout(), metrics);
+                         config.ReadTimeout(), kJsonType, metrics->data(),
+                         metrics->size());
   if (res != 200) {
     Logger()->error("Failed to POST: {}", res);
     atlas_registry.counter(errorId->WithTag(freq_tag))->Increment();
@@ -355,84 +368,32 @@ void SubscriptionManager::SendMetricsForInterval(int64_t millis) noexcept {
   auto timer = atlas_registry.timer(sendId->WithTag(freq_tag));
   auto cfg = config_manager_.GetConfig();
   const auto& sub_results = registry_.GetLwcMetricsForInterval(*cfg, millis);
-  util::http http_client;
+  util::http http_client{cfg->GzipOptions()};
 
   auto batch_size =
-      static_cast<SubscriptionResults::difference_type>(cfg->BatchSize());
-  auto from = sub_results.begin();
-  auto end = sub_results.end();
+      static_cast<SubscriptionMetrics::difference_type>(cfg->BatchSize());
+  auto from = sub_results.metrics.begin();
+  auto end = sub_results.metrics.end();
   while (from != end) {
     auto to_end = std::distance(from, end);
     auto to_advance = std::min(batch_size, to_end);
     auto to = from;
     std::advance(to, to_advance);
-    SendBatchToLwc(http_client, *cfg, millis, from, to);
+    SendBatchToLwc(http_client, *cfg, &dump_writer_, millis, sub_results, from,
+                   to);
     from = to;
   }
   timer->Record(clock.MonotonicTime() - start);
 }
 
-// not static for testing
-rapidjson::Document MeasurementsToJson(
-    int64_t now_millis,
-    const interpreter::TagsValuePairs::const_iterator& first,
-    const interpreter::TagsValuePairs::const_iterator& last, bool validate,
-    int64_t* metrics_added) {
-  using rapidjson::Document;
-  using rapidjson::kArrayType;
-  using rapidjson::kObjectType;
-  using rapidjson::SizeType;
-  using rapidjson::Value;
-
-  int64_t added = 0;
-  Document payload{kObjectType};
-  auto& alloc = payload.GetAllocator();
-
-  Value common_tags_section{kObjectType};
-
-  Value json_metrics{kArrayType};
-  for (auto it = first; it < last; it++) {
-    const auto& measure = *it;
-    if (std::isnan(measure.value)) {
-      continue;
-    }
-    if (validate && !validation::IsValid(measure.tags)) {
-      continue;
-    }
-    Value json_metric{kObjectType};
-    Value json_metric_tags{kObjectType};
-
-    for (const auto& tag : measure.tags) {
-      const char* k_str = util::ToValidCharset(tag.first).get();
-      const char* v_str = util::EncodeValueForKey(tag.second, tag.first).get();
-
-      Value k(k_str, static_cast<SizeType>(strlen(k_str)), alloc);
-      Value v(v_str, static_cast<SizeType>(strlen(v_str)), alloc);
-      json_metric_tags.AddMember(k, v, alloc);
-    }
-    ++added;
-
-    json_metric.AddMember("tags", json_metric_tags, alloc);
-    json_metric.AddMember("start", now_millis, alloc);
-    json_metric.AddMember("value", measure.value, alloc);
-    json_metrics.PushBack(json_metric, alloc);
-  }
-
-  payload.AddMember("tags", common_tags_section, alloc);
-  payload.AddMember("metrics", json_metrics, alloc);
-
-  *metrics_added = added;
-  return payload;
-}
-
 static void SendBatch(const util::http& client, const util::Config& config,
+                      validation::ValidationCache* validation,
+                      RetryQueue* retries, util::DumpWriter* dump_writer,
                       int64_t now_millis,
                       const interpreter::TagsValuePairs::const_iterator& first,
                       const interpreter::TagsValuePairs::const_iterator& last) {
   static auto timer = atlas_registry.timer("atlas.client.mainBatch");
-  const static Tags atlas_client_tags{
-      {intern_str("class"), intern_str("NetflixAtlasObserver")},
-      {intern_str("id"), intern_str("main-vip")}};
+  const auto& atlas_client_tags = PublishCounterTags();
   static auto total = atlas_registry.counter(
       atlas_registry.CreateId("numMetricsTotal", atlas_client_tags));
   static auto sent = atlas_registry.counter(
@@ -447,10 +408,12 @@ static void SendBatch(const util::http& client, const util::Config& config,
   auto num_measurements = std::distance(first, last);
   logger->info("Sending batch of {} metrics to {}", num_measurements,
                config.PublishEndpoint());
-  // TODO(dmuino): retries
   int64_t added = 0;
   auto num_metrics = static_cast<int64_t>(num_measurements);
-  auto payload = MeasurementsToJson(now_millis, first, last, true, &added);
+  const auto& encoder = EncoderFor(config.PublishFormat());
+  // shared by the post, the dump and the retry queue
+  auto payload = std::make_shared<const std::string>(encoder.Encode(
+      now_millis, config.CommonTags(), first, last, validation, &added));
   if (added != num_metrics) {
     validationErrors->Add(num_metrics - added);
   }
@@ -461,21 +424,29 @@ static void SendBatch(const util::http& client, const util::Config& config,
 
   auto start = atlas_registry.clock().MonotonicTime();
   auto http_res = client.post(config.PublishEndpoint(), config.ConnectTimeout(),
-                              config.ReadTimeout(), payload);
+                              config.ReadTimeout(), encoder.ContentType(),
+                              payload->data(), payload->size());
   timer->Record(atlas_registry.clock().MonotonicTime() - start);
   if (config.ShouldDumpMetrics()) {
-    DumpJson("/tmp", "main_batch_", payload);
+    DumpPayload(dump_writer, "main_batch_", encoder.Extension(), payload);
   }
-  if (http_res != 200) {
+  retries->RecordStatus(http_res);
+  if (http_res == 200) {
+    sent->Add(added);
+  } else if (RetryQueue::ShouldRetry(http_res)) {
+    logger->warn("Unable to send batch of {} measurements to publish: {}. "
+                 "Will retry",
+                 num_measurements, http_res);
+    RecordRetryResult(retries->Add(encoder.ContentType(), std::move(payload),
+                                   added, atlas_registry.clock().WallTime()));
+  } else {
     logger->error("Unable to send batch of {} measurements to publish: {}",
                   num_measurements, http_res);
 
     atlas_registry
-        .counter(errorsId->WithTag(httpErr)->WithTag(
-            Tag::of("statusCode", std::to_string(http_res))))
+        .counter(errorsId->WithTags(
+            {httpErr, Tag::of("statusCode", std::to_string(http_res))}))
         ->Add(added);
-  } else {
-    sent->Add(added);
   }
 }
 
@@ -483,8 +454,8 @@ void SubscriptionManager::PushMeasurements(
     int64_t now_millis, const interpreter::TagsValuePairs& measurements) const {
   using interpreter::TagsValuePairs;
 
-  util::http client;
   auto cfg = config_manager_.GetConfig();
+  util::http client{cfg->GzipOptions()};
   auto batch_size =
       static_cast<TagsValuePairs::difference_type>(cfg->BatchSize());
 
@@ -495,15 +466,54 @@ void SubscriptionManager::PushMeasurements(
     auto to_advance = std::min(batch_size, to_end);
     auto to = from;
     std::advance(to, to_advance);
-    SendBatch(client, *cfg, now_millis, from, to);
+    SendBatch(client, *cfg, &validation_cache_, &retry_queue_, &dump_writer_,
+              now_millis, from, to);
     from = to;
   }
 }
 
+void SubscriptionManager::RetryFailedBatches() noexcept {
+  static auto queued = atlas_registry.gauge("atlas.client.retryQueueSize");
+  static auto queued_age = atlas_registry.gauge("atlas.client.retryQueueAge");
+  static auto spilled = atlas_registry.gauge("atlas.client.spilledBatches");
+  static auto spilled_age = atlas_registry.gauge("atlas.client.spilledAge");
+
+  try {
+    auto cfg = config_manager_.GetConfig();
+    util::http client{cfg->GzipOptions()};
+    auto sender = [&cfg, &client](const std::string& content_type,
+                                  const std::string& payload) {
+      return client.post(cfg->PublishEndpoint(), cfg->ConnectTimeout(),
+                         cfg->ReadTimeout(), content_type.c_str(),
+                         payload.data(), payload.size());
+    };
+    auto now = atlas_registry.clock().WallTime();
+    RecordRetryResult(retry_queue_.Run(sender, now));
+
+    // ages in seconds
+    auto oldest = retry_queue_.OldestMillis();
+    auto oldest_spilled = retry_queue_.OldestSpilledMillis();
+    queued->Update(retry_queue_.size());
+    queued_age->Update(oldest > 0 ? (now - oldest) / 1e3 : 0.0);
+    spilled->Update(retry_queue_.spilled());
+    spilled_age->Update(oldest_spilled > 0 ? (now - oldest_spilled) / 1e3
+                                           : 0.0);
+  } catch (const std::exception& e) {
+    Logger()->error("Error retrying batches for the main publish cluster: {}",
+                    e.what());
+  }
+}
+
 void SubscriptionManager::UpdateMetrics() noexcept {
   static auto pool_size = atlas_registry.gauge("atlas.client.strPoolSize");
   static auto pool_alloc = atlas_registry.gauge("atlas.client.strPoolAlloc");
 
+  // runs once per step, which gives strings that are no longer used a full
+  // step before they are reclaimed
+  auto expired = registry_.RemoveExpiredMeters();
+  auto reclaimed = util::the_str_pool().Sweep();
+  Logger()->debug("Removed {} expired meters, reclaimed {} strings", expired,
+                  reclaimed);
   pool_size->Update(util::the_str_pool().pool_size());
   pool_alloc->Update(util::the_str_pool().alloc_size());
 }
@@ -519,6 +529,8 @@ void SubscriptionManager::SendToMain() {
   auto timestamp =
       clock.WallTime() / kMainFrequencyMillis * kMainFrequencyMillis;
   PushMeasurements(timestamp, metrics);
+  // forget the verdicts for series that are gone
+  validation_cache_.Rotate();
   auto nanos = clock.MonotonicTime() - start;
   auto millis = nanos / 1e6;
   Logger()->info("Sent {} metrics to {} in {}ms", metrics.size(),
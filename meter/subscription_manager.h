@@ -1,7 +1,11 @@
 #pragma once
 
 #include "../util/config_manager.h"
+#include "../util/dump_writer.h"
+#include "../util/scheduler.h"
+#include "retry_queue.h"
 #include "subscription_registry.h"
+#include "validation.h"
 #include <set>
 
 namespace atlas {
@@ -30,16 +34,25 @@ class SubscriptionManager {
   std::set<int> sender_intervals_;
 
   std::string current_etag;
-  // unfortunately no atomic unique ptrs available yet,
-  // so we use a raw pointer to the current subscriptions
-  std::atomic<Subscriptions*> subscriptions_{nullptr};
   SubscriptionRegistry& registry_;
   std::atomic<bool> should_run_{false};
+  uint64_t refresher_runs_{0};
+  const double jitter_;
+  // verdicts for the series sent to the main publish cluster
+  mutable validation::ValidationCache validation_cache_;
+  // batches that failed to reach the main publish cluster
+  mutable RetryQueue retry_queue_;
+  // payloads dumped for debugging, written in the background
+  mutable util::DumpWriter dump_writer_;
+  // runs the refresher and the senders
+  util::Scheduler scheduler_;
 
   void SubRefresher() noexcept;
-  void MainSender(std::chrono::seconds initial_delay) noexcept;
+  void MainSender() noexcept;
   void SubSender(int64_t millis) noexcept;
   void SendMetricsForInterval(int64_t millis) noexcept;
+  void RetryFailedBatches() noexcept;
+  std::chrono::milliseconds StepOffset(int64_t step_millis) const noexcept;
 
  protected:
   // for testing
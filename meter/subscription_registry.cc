@@ -10,6 +10,7 @@
 
 #include <numeric>
 #include <sstream>
+#include <unordered_set>
 
 using atlas::util::Logger;
 
@@ -67,6 +68,21 @@ class SubscriptionRegistry::impl {
     return res;
   }
 
+  size_t RemoveExpired() noexcept {
+    std::lock_guard<std::mutex> lock(meters_mutex);
+    size_t removed = 0;
+    for (auto it = meters_.begin(); it != meters_.end();) {
+      // meters someone else is holding on to might be updated again
+      if (it->second.use_count() == 1 && it->second->HasExpired()) {
+        it = meters_.erase(it);
+        ++removed;
+      } else {
+        ++it;
+      }
+    }
+    return removed;
+  }
+
  private:
   std::unique_ptr<interpreter::Interpreter> interpreter_;
   // TODO(dmuino) use a concurrent map
@@ -114,24 +130,140 @@ std::shared_ptr<DistributionSummary> SubscriptionRegistry::distribution_summary(
   return CreateAndRegisterAsNeeded<SubscriptionDistributionSummary>(id);
 }
 
-void SubscriptionRegistry::update_subscriptions(const Subscriptions* new_subs) {
+struct SubscriptionRegistry::CompiledSubscription {
+  CompiledSubscription(
+      const Subscription& s,
+      std::vector<std::shared_ptr<interpreter::MultipleResults>> exprs)
+      : subscription(s),
+        id(util::acquire_str(s.id)),
+        expressions(std::move(exprs)) {}
+  CompiledSubscription(const CompiledSubscription&) = delete;
+  CompiledSubscription& operator=(const CompiledSubscription&) = delete;
+  ~CompiledSubscription() { util::release_ref(id); }
+
+  const Subscription subscription;
+  // interned once, so results can refer to it. Counted, so the ids of
+  // removed subscriptions can be reclaimed
+  const util::StrRef id;
+  const std::vector<std::shared_ptr<interpreter::MultipleResults>> expressions;
+};
+
+using MultipleResultsList =
+    std::vector<std::shared_ptr<interpreter::MultipleResults>>;
+
+static MultipleResultsList compile(const interpreter::Interpreter& inter,
+                                   const std::string& expression) {
+  auto stack = std::make_unique<interpreter::Context::Stack>();
+  auto context = std::make_unique<interpreter::Context>(std::move(stack));
+  inter.Execute(context.get(), expression);
+
+  // for each expression on the stack
+  MultipleResultsList result;
+  while (context->StackSize() > 0) {
+    auto expr = context->PopExpression();
+    auto by = interpreter::expression::GetMultipleResults(std::move(expr));
+    if (by) {
+      result.push_back(std::move(by));
+    }
+  }
+  return result;
+}
+
+static interpreter::TagsValuePairs apply(
+    const MultipleResultsList& expressions,
+    const interpreter::TagsValuePairs& tagsValuePairs) {
+  interpreter::TagsValuePairs results;
+  for (const auto& by : expressions) {
+    auto expression_result = by->Apply(tagsValuePairs);
+    std::move(expression_result.begin(), expression_result.end(),
+              std::back_inserter(results));
+  }
+  return results;
+}
+
+std::shared_ptr<const SubscriptionRegistry::CompiledSubscription>
+SubscriptionRegistry::Compile(const Subscription& subscription) const {
+  return std::make_shared<const CompiledSubscription>(
+      subscription, compile(*impl_->GetInterpreter(), subscription.expression));
+}
+
+SubscriptionsDiff SubscriptionRegistry::update_subscriptions(
+    const Subscriptions* new_subs) {
   static auto num_pollers = atlas_registry.gauge("atlas.client.numPollers");
+  static auto subs_added = atlas_registry.gauge("atlas.client.subsAdded");
+  static auto subs_removed = atlas_registry.gauge("atlas.client.subsRemoved");
+  static auto subs_unchanged =
+      atlas_registry.gauge("atlas.client.subsUnchanged");
+  auto logger = Logger();
   auto pollers_updated = false;
+  SubscriptionsDiff diff{0, 0, 0};
+
+  // the first subscription with a given id wins
+  std::vector<const Subscription*> unique;
+  unique.reserve(new_subs->size());
+  std::unordered_set<std::string> ids;
+  for (const auto& s : *new_subs) {
+    if (ids.insert(s.id).second) {
+      unique.push_back(&s);
+    } else {
+      logger->warn("Ignoring duplicate subscription id {}: {}", s.id,
+                   s.expression);
+    }
+  }
+
+  // compile new or changed subscriptions before taking the lock, so other
+  // refreshes are not held up while the interpreter runs
+  auto changed = subscriptions_.Read([&unique](const SubscriptionsMap& subs) {
+    std::vector<const Subscription*> res;
+    for (auto s : unique) {
+      auto existing = subs.find(s->id);
+      if (existing == subs.end() || !(existing->second->subscription == *s)) {
+        res.push_back(s);
+      }
+    }
+    return res;
+  });
+  SubscriptionsMap compiled;
+  for (auto s : changed) {
+    compiled.emplace(s->id, Compile(*s));
+  }
+
+  std::unique_ptr<SubscriptionsMap> updated{new SubscriptionsMap};
+  updated->reserve(unique.size());
   std::lock_guard<std::mutex> guard(subscriptions_mutex);
+  // only writers replace the map, and they hold the lock
+  const auto* current = &subscriptions_.Current();
+  for (auto s : unique) {
+    auto existing = current->find(s->id);
+    if (existing != current->end() && existing->second->subscription == *s) {
+      ++diff.unchanged;
+      updated->insert(*existing);
+      continue;
+    }
 
-  subscriptions_ = new_subs;
-  for (auto& s : *subscriptions_) {
-    auto freq = s.frequency;
+    ++diff.added;
+    // another refresh could have changed the map since we compiled
+    auto compiled_sub = compiled.find(s->id);
+    updated->emplace(s->id, compiled_sub != compiled.end()
+                                ? std::move(compiled_sub->second)
+                                : Compile(*s));
+    auto freq = s->frequency;
     if (!AlreadySeen(freq)) {
       poller_freq_.push_back(freq);
       pollers_updated = true;
     }
   }
+  diff.removed = current->size() - diff.unchanged;
+  subscriptions_.Update(std::move(updated));
 
   num_pollers->Update(poller_freq_.size());
+  subs_added->Update(diff.added);
+  subs_removed->Update(diff.removed);
+  subs_unchanged->Update(diff.unchanged);
   if (pollers_updated) {
     impl_->UpdatePollersForMeters();
   }
+  return diff;
 }
 
 bool SubscriptionRegistry::AlreadySeen(int s) noexcept {
@@ -143,6 +275,10 @@ Registry::Meters SubscriptionRegistry::meters() const noexcept {
   return impl_->GetMeters();
 }
 
+size_t SubscriptionRegistry::RemoveExpiredMeters() noexcept {
+  return impl_->RemoveExpired();
+}
+
 void SubscriptionRegistry::RegisterMonitor(
     std::shared_ptr<Meter> meter) noexcept {
   InsertIfNeeded(meter);
@@ -221,6 +357,7 @@ interpreter::TagsValuePairs SubscriptionRegistry::GetMainMeasurements(
   if (rules.empty()) {
     logger->info("No publish configuration. Assuming :all for {} measurements.",
                  all.size());
+    result.reserve(all.size());
     std::transform(all.begin(), all.end(), std::back_inserter(result),
                    [&common_tags](const Measurement& m) {
                      return TagsValuePair::from(m, common_tags);
@@ -284,7 +421,7 @@ SubscriptionResults SubscriptionRegistry::GetLwcMetricsForInterval(
   SubscriptionResults result;
   // get all the subscriptions for a given interval (ignoring main)
   auto subs = SubsForInterval(frequency);
-  auto frequency_str = std::to_string(frequency).c_str();
+  auto frequency_str = std::to_string(frequency);
   atlas_registry.gauge(subsId->WithTag(Tag::of("freq", frequency_str)))
       ->Update(subs.size());
 
@@ -293,21 +430,25 @@ SubscriptionResults SubscriptionRegistry::GetLwcMetricsForInterval(
 
   // gather all metrics generated by our subscriptions
   const auto& common_tags = config.CommonTags();
-  for (auto& s : subs) {
-    TagsValuePairs tagsValuePairs;
+  // the input is the same for every subscription
+  TagsValuePairs tagsValuePairs;
+  if (!subs.empty()) {
+    tagsValuePairs.reserve(measurements.size());
     std::transform(measurements.begin(), measurements.end(),
                    std::back_inserter(tagsValuePairs),
                    [&common_tags](const Measurement& m) {
                      return TagsValuePair::from(m, common_tags);
                    });
-    auto pairs = evaluate(s.expression, tagsValuePairs);
-    std::transform(pairs.begin(), pairs.end(), std::back_inserter(result),
-                   [&s](const TagsValuePair& pair) {
-                     return SubscriptionMetric{s.id, pair.tags, pair.value};
-                   });
+  }
+  if (!tagsValuePairs.empty()) {
+    result.ids.reserve(subs.size());
+    result.values.reserve(subs.size());
+    for (auto& compiled : subs) {
+      result.Add(compiled->id, apply(compiled->expressions, tagsValuePairs));
+    }
   }
   atlas_registry.gauge(measurementsId->WithTag(Tag::of("freq", frequency_str)))
-      ->Update(result.size());
+      ->Update(result.metrics.size());
   return result;
 }
 
@@ -345,16 +486,17 @@ Measurements SubscriptionRegistry::GetMeasurements(int64_t frequency) const {
   return res;
 }
 
-Subscriptions SubscriptionRegistry::SubsForInterval(int64_t frequency) const
-    noexcept {
-  std::lock_guard<std::mutex> guard(subscriptions_mutex);
-  Subscriptions res;
-  std::copy_if(
-      std::begin(*subscriptions_), std::end(*subscriptions_),
-      std::back_inserter(res), [frequency](const Subscription& subscription) {
-        return subscription.frequency == frequency && !subscription.id.empty();
-      });
-
+SubscriptionRegistry::CompiledSubscriptions
+SubscriptionRegistry::SubsForInterval(int64_t frequency) const noexcept {
+  CompiledSubscriptions res;
+  subscriptions_.Read([frequency, &res](const SubscriptionsMap& subs) {
+    for (const auto& kv : subs) {
+      const auto& subscription = kv.second->subscription;
+      if (subscription.frequency == frequency && !subscription.id.empty()) {
+        res.push_back(kv.second);
+      }
+    }
+  });
   return res;
 }
 
@@ -363,31 +505,17 @@ SubscriptionRegistry::SubscriptionRegistry(
     const Clock* clock) noexcept
     : impl_(std::make_unique<impl>(std::move(interpreter))),
       clock_{clock},
-      poller_freq_{util::kMainFrequencyMillis} {}
+      poller_freq_{util::kMainFrequencyMillis},
+      subscriptions_{std::unique_ptr<const SubscriptionsMap>(
+          new SubscriptionsMap)} {}
 
 interpreter::TagsValuePairs SubscriptionRegistry::evaluate(
     const std::string& expression,
     const interpreter::TagsValuePairs& tagsValuePairs) const {
-  interpreter::TagsValuePairs results;
   if (tagsValuePairs.empty()) {
-    return results;
+    return interpreter::TagsValuePairs();
   }
-  auto stack = std::make_unique<interpreter::Context::Stack>();
-  auto context = std::make_unique<interpreter::Context>(std::move(stack));
-  impl_->GetInterpreter()->Execute(context.get(), expression);
-
-  // for each expression on the stack
-  while (context->StackSize() > 0) {
-    auto expr = context->PopExpression();
-    auto by = interpreter::expression::GetMultipleResults(std::move(expr));
-    if (by) {
-      auto expression_result = by->Apply(tagsValuePairs);
-      std::move(expression_result.begin(), expression_result.end(),
-                std::back_inserter(results));
-    }
-  }
-
-  return results;
+  return apply(compile(*impl_->GetInterpreter(), expression), tagsValuePairs);
 }
 
 SubscriptionRegistry::~SubscriptionRegistry() = default;
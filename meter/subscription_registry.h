@@ -1,11 +1,13 @@
 #pragma once
 
 #include "../util/config.h"
+#include "../util/snapshot.h"
 #include "registry.h"
 #include "stepnumber.h"
 #include "subscription.h"
 #include "subscription_max_gauge.h"
 #include <array>
+#include <unordered_map>
 
 namespace atlas {
 
@@ -50,7 +52,15 @@ class SubscriptionRegistry : public Registry {
 
   Meters meters() const noexcept override;
 
-  void update_subscriptions(const Subscriptions* new_subs);
+  /// Forget the meters that have expired and are not referenced outside the
+  /// registry, so their ids and strings can be reclaimed. Returns the number
+  /// of meters removed
+  size_t RemoveExpiredMeters() noexcept;
+
+  /// Replace the current subscriptions. Only the expressions of new or
+  /// changed subscriptions are compiled, before taking the lock. When ids
+  /// repeat, the first subscription wins and the others are logged
+  SubscriptionsDiff update_subscriptions(const Subscriptions* new_subs);
 
   SubscriptionResults GetLwcMetricsForInterval(const util::Config& config,
                                                int64_t frequency) const;
@@ -85,8 +95,8 @@ class SubscriptionRegistry : public Registry {
  private:
   const Clock* clock_;
 
-  // guarantee that only one thread will call update_subscription
-  mutable std::mutex subscriptions_mutex;
+  // serializes the writers of subscriptions_ and poller_freq_
+  std::mutex subscriptions_mutex;
 
   std::shared_ptr<Meter> InsertIfNeeded(std::shared_ptr<Meter> meter) noexcept;
   std::shared_ptr<Meter> GetMeter(IdPtr id) noexcept;
@@ -119,12 +129,26 @@ class SubscriptionRegistry : public Registry {
 
   Pollers poller_freq_;
 
-  const Subscriptions* subscriptions_{nullptr};
+  struct CompiledSubscription;
+  using CompiledSubscriptions =
+      std::vector<std::shared_ptr<const CompiledSubscription>>;
+
+  using SubscriptionsMap =
+      std::unordered_map<std::string,
+                         std::shared_ptr<const CompiledSubscription>>;
+
+  // current subscriptions keyed by id. Each update publishes a new immutable
+  // map, so readers never lock, and the previous map is freed once no reader
+  // can be looking at it
+  util::Snapshot<SubscriptionsMap> subscriptions_;
 
   bool AlreadySeen(int s) noexcept;
 
+  std::shared_ptr<const CompiledSubscription> Compile(
+      const Subscription& subscription) const;
+
  protected:  // for testing
-  Subscriptions SubsForInterval(int64_t frequency) const noexcept;
+  CompiledSubscriptions SubsForInterval(int64_t frequency) const noexcept;
 
   Measurements GetMeasurements(int64_t frequency) const;
 
@@ -0,0 +1,398 @@
+#include "subscriptions_parser.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+
+namespace atlas {
+namespace meter {
+
+namespace {
+inline bool is_space(char c) noexcept {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// characters that can be part of a number or a literal (true, false, null).
+// Tokens that are neither are rejected once they end
+inline bool is_scalar_char(char c) noexcept {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z') || c == '.' || c == '+' || c == '-';
+}
+
+inline bool is_digit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and sets integral when there
+// is neither a fraction nor an exponent
+bool is_json_number(const std::string& s, bool* integral) noexcept {
+  auto p = s.c_str();
+  if (*p == '-') ++p;
+  if (*p == '0') {
+    ++p;
+  } else if (is_digit(*p)) {
+    while (is_digit(*p)) ++p;
+  } else {
+    return false;
+  }
+  *integral = true;
+  if (*p == '.') {
+    ++p;
+    if (!is_digit(*p)) return false;
+    while (is_digit(*p)) ++p;
+    *integral = false;
+  }
+  if (*p == 'e' || *p == 'E') {
+    ++p;
+    if (*p == '+' || *p == '-') ++p;
+    if (!is_digit(*p)) return false;
+    while (is_digit(*p)) ++p;
+    *integral = false;
+  }
+  return *p == '\0';
+}
+
+// a frequency must be a whole number of milliseconds that fits in an int64
+bool to_frequency(const std::string& s, bool integral, int64_t* n) noexcept {
+  errno = 0;
+  if (integral) {
+    *n = std::strtoll(s.c_str(), nullptr, 10);
+    return errno == 0;
+  }
+  auto d = std::strtod(s.c_str(), nullptr);
+  if (errno != 0 || !std::isfinite(d) || std::trunc(d) != d ||
+      std::fabs(d) >= 9223372036854775808.0) {
+    return false;
+  }
+  *n = static_cast<int64_t>(d);
+  return true;
+}
+
+inline int hex_value(char c) noexcept {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+void append_utf8(std::string* s, uint32_t cp) {
+  if (cp < 0x80) {
+    s->push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    s->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    s->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    s->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    s->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    s->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    s->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    s->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    s->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    s->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+}  // namespace
+
+SubscriptionsParser::SubscriptionsParser()
+    : subs_(std::make_unique<Subscriptions>()) {}
+
+bool SubscriptionsParser::Feed(const char* data, size_t size) {
+  for (size_t i = 0; i < size && state_ != State::Error; ++i) {
+    auto c = data[i];
+    switch (state_) {
+      case State::String: {
+        // copy runs of plain characters in one go
+        auto start = i;
+        while (i < size && data[i] != '"' && data[i] != '\\' &&
+               static_cast<unsigned char>(data[i]) >= 0x20) {
+          ++i;
+        }
+        token_.append(data + start, i - start);
+        if (i == size) {
+          break;
+        }
+        c = data[i];
+        if (c == '"') {
+          EndString();
+        } else if (c == '\\') {
+          state_ = State::Escape;
+        } else {
+          Fail();
+        }
+        break;
+      }
+      case State::Escape:
+        state_ = State::String;
+        switch (c) {
+          case '"':
+          case '\\':
+          case '/':
+            token_.push_back(c);
+            break;
+          case 'b':
+            token_.push_back('\b');
+            break;
+          case 'f':
+            token_.push_back('\f');
+            break;
+          case 'n':
+            token_.push_back('\n');
+            break;
+          case 'r':
+            token_.push_back('\r');
+            break;
+          case 't':
+            token_.push_back('\t');
+            break;
+          case 'u':
+            code_point_ = 0;
+            hex_digits_ = 0;
+            state_ = State::Unicode;
+            break;
+          default:
+            Fail();
+        }
+        break;
+      case State::Unicode: {
+        auto v = hex_value(c);
+        if (v < 0) {
+          Fail();
+          break;
+        }
+        code_point_ = (code_point_ << 4) | static_cast<uint32_t>(v);
+        if (++hex_digits_ == 4) {
+          EndCodePoint();
+        }
+        break;
+      }
+      case State::SurrogateEscape:
+        state_ = c == '\\' ? State::SurrogateU : State::Error;
+        break;
+      case State::SurrogateU:
+        code_point_ = 0;
+        hex_digits_ = 0;
+        state_ = c == 'u' ? State::Unicode : State::Error;
+        break;
+      case State::Scalar:
+        if (is_scalar_char(c)) {
+          token_.push_back(c);
+        } else {
+          EndScalar();
+          if (state_ != State::Error) {
+            Structural(c);
+          }
+        }
+        break;
+      case State::Slash:
+        if (c == '/') {
+          state_ = State::LineComment;
+        } else if (c == '*') {
+          state_ = State::BlockComment;
+        } else {
+          Fail();
+        }
+        break;
+      case State::LineComment:
+        if (c == '\n') {
+          state_ = resume_;
+        }
+        break;
+      case State::BlockComment:
+        if (c == '*') {
+          state_ = State::BlockCommentStar;
+        }
+        break;
+      case State::BlockCommentStar:
+        if (c == '/') {
+          state_ = resume_;
+        } else if (c != '*') {
+          state_ = State::BlockComment;
+        }
+        break;
+      default:
+        Structural(c);
+    }
+  }
+  return state_ != State::Error;
+}
+
+bool SubscriptionsParser::Finish() noexcept {
+  if (state_ == State::Scalar) {
+    EndScalar();
+  } else if (state_ == State::LineComment) {
+    state_ = resume_;
+  }
+  return state_ == State::Done;
+}
+
+std::unique_ptr<Subscriptions> SubscriptionsParser::Release() noexcept {
+  auto res = std::move(subs_);
+  subs_ = std::make_unique<Subscriptions>();
+  return res;
+}
+
+void SubscriptionsParser::Structural(char c) {
+  if (is_space(c)) {
+    return;
+  }
+  if (c == '/') {
+    resume_ = state_;
+    state_ = State::Slash;
+    return;
+  }
+
+  switch (state_) {
+    case State::ValueOrEnd:
+      if (c == ']') {
+        EndContainer(c);
+        return;
+      }
+    // fall through
+    case State::Value:
+      if (c == '{') {
+        StartContainer(c);
+        state_ = State::KeyOrEnd;
+      } else if (c == '[') {
+        StartContainer(c);
+        state_ = State::ValueOrEnd;
+      } else if (c == '"') {
+        token_.clear();
+        is_key_ = false;
+        state_ = State::String;
+      } else if (is_scalar_char(c)) {
+        token_.assign(1, c);
+        state_ = State::Scalar;
+      } else {
+        Fail();
+      }
+      break;
+    case State::KeyOrEnd:
+      if (c == '}') {
+        EndContainer(c);
+        return;
+      }
+    // fall through
+    case State::Key:
+      if (c == '"') {
+        token_.clear();
+        is_key_ = true;
+        state_ = State::String;
+      } else {
+        Fail();
+      }
+      break;
+    case State::Colon:
+      state_ = c == ':' ? State::Value : State::Error;
+      break;
+    case State::CommaOrEnd:
+      if (c == ',') {
+        state_ = stack_.back() == '{' ? State::Key : State::Value;
+      } else if (c == '}' || c == ']') {
+        EndContainer(c);
+      } else {
+        Fail();
+      }
+      break;
+    default:
+      // only whitespace and comments are allowed after the document
+      Fail();
+  }
+}
+
+void SubscriptionsParser::StartContainer(char c) {
+  if (c == '[' && stack_.size() == 1 && stack_[0] == '{' &&
+      key_ == "expressions") {
+    in_expressions_ = true;
+  } else if (c == '{' && in_expressions_ && stack_.size() == 2) {
+    in_record_ = true;
+    has_id_ = has_expression_ = has_frequency_ = false;
+  }
+  stack_.push_back(c);
+}
+
+void SubscriptionsParser::EndContainer(char c) {
+  auto open = c == '}' ? '{' : '[';
+  if (stack_.empty() || stack_.back() != open) {
+    Fail();
+    return;
+  }
+  stack_.pop_back();
+
+  if (in_record_ && stack_.size() == 2) {
+    in_record_ = false;
+    // ignore incomplete subscriptions
+    if (has_id_ && has_expression_ && has_frequency_) {
+      subs_->push_back(
+          Subscription{std::move(id_), frequency_, std::move(expression_)});
+    }
+  } else if (in_expressions_ && stack_.size() == 1) {
+    in_expressions_ = false;
+  }
+  EndValue();
+}
+
+void SubscriptionsParser::EndValue() noexcept {
+  state_ = stack_.empty() ? State::Done : State::CommaOrEnd;
+}
+
+bool SubscriptionsParser::AtRecordMember() const noexcept {
+  return in_record_ && stack_.size() == 3;
+}
+
+void SubscriptionsParser::EndString() {
+  if (is_key_) {
+    key_.swap(token_);
+    state_ = State::Colon;
+    return;
+  }
+
+  if (AtRecordMember()) {
+    if (key_ == "id") {
+      id_.swap(token_);
+      has_id_ = true;
+    } else if (key_ == "expression") {
+      expression_.swap(token_);
+      has_expression_ = true;
+    }
+  }
+  EndValue();
+}
+
+void SubscriptionsParser::EndScalar() {
+  if (token_ != "true" && token_ != "false" && token_ != "null") {
+    bool integral;
+    if (!is_json_number(token_, &integral)) {
+      Fail();
+      return;
+    }
+    // a subscription with an invalid frequency is ignored like an
+    // incomplete one
+    if (AtRecordMember() && key_ == "frequency") {
+      has_frequency_ = to_frequency(token_, integral, &frequency_);
+    }
+  }
+  EndValue();
+}
+
+void SubscriptionsParser::EndCodePoint() {
+  state_ = State::String;
+  auto cp = code_point_;
+  if (high_surrogate_ != 0) {
+    if (cp < 0xDC00 || cp > 0xDFFF) {
+      Fail();
+      return;
+    }
+    cp = 0x10000 + ((high_surrogate_ - 0xD800) << 10) + (cp - 0xDC00);
+    high_surrogate_ = 0;
+  } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+    // expect the low surrogate next
+    high_surrogate_ = cp;
+    state_ = State::SurrogateEscape;
+    return;
+  } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+    Fail();
+    return;
+  }
+  append_utf8(&token_, cp);
+}
+
+}  // namespace meter
+}  // namespace atlas
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "subscription.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace atlas {
+namespace meter {
+
+/// Incremental parser for the subscriptions returned by the lwc api:
+/// {"expressions": [{"id": ..., "frequency": ..., "expression": ...}, ...]}
+///
+/// The payload can be fed in chunks of any size as it arrives, so neither the
+/// whole document nor a DOM for it is ever built. Other members are validated
+/// and skipped.
+class SubscriptionsParser {
+ public:
+  SubscriptionsParser();
+
+  /// Parse the next chunk of the payload. Returns false once the payload is
+  /// known to be invalid, in which case any further input is ignored
+  bool Feed(const char* data, size_t size);
+
+  /// Signal the end of the payload. Returns whether a complete document was
+  /// parsed
+  bool Finish() noexcept;
+
+  /// Take the subscriptions parsed so far
+  std::unique_ptr<Subscriptions> Release() noexcept;
+
+ private:
+  enum class State {
+    Value,
+    ValueOrEnd,
+    KeyOrEnd,
+    Key,
+    Colon,
+    CommaOrEnd,
+    String,
+    Escape,
+    Unicode,
+    SurrogateEscape,
+    SurrogateU,
+    Scalar,
+    Slash,
+    LineComment,
+    BlockComment,
+    BlockCommentStar,
+    Done,
+    Error
+  };
+
+  State state_{State::Value};
+  // state to go back to after a comment
+  State resume_{State::Value};
+  // open containers: '{' or '['
+  std::vector<char> stack_;
+  std::string token_;
+  std::string key_;
+  bool is_key_{false};
+  uint32_t code_point_{0};
+  uint32_t high_surrogate_{0};
+  int hex_digits_{0};
+
+  // whether we're inside the expressions array, or one of its elements
+  bool in_expressions_{false};
+  bool in_record_{false};
+  std::string id_;
+  std::string expression_;
+  int64_t frequency_{0};
+  bool has_id_{false};
+  bool has_expression_{false};
+  bool has_frequency_{false};
+
+  std::unique_ptr<Subscriptions> subs_;
+
+  void Structural(char c);
+  void StartContainer(char c);
+  void EndContainer(char c);
+  void EndValue() noexcept;
+  void EndString();
+  void EndScalar();
+  void EndCodePoint();
+  bool AtRecordMember() const noexcept;
+  void Fail() noexcept { state_ = State::Error; }
+};
+
+}  // namespace meter
+}  // namespace atlas
@@ -1,7 +1,7 @@
 #include "validation.h"
 #include "../util/dump.h"
 #include "../util/logger.h"
-#include "../util/strings.h"
+#include <cstring>
 #include <sstream>
 #include <unordered_set>
 
@@ -9,57 +9,58 @@ namespace atlas {
 namespace meter {
 namespace validation {
 
+using util::intern_str;
+
 static constexpr size_t MAX_KEY_LENGTH = 60;
 static constexpr size_t MAX_VAL_LENGTH = 120;
 static constexpr size_t MAX_USER_TAGS = 20;
 static constexpr size_t MAX_NAME_LENGTH = 255;
 
-using util::StartsWith;
-
-static bool is_key_restricted(const std::string& k) noexcept {
-  return StartsWith(k, "nf.") || StartsWith(k, "atlas.");
+template <size_t N>
+static bool starts_with(const char* s, const char (&prefix)[N]) noexcept {
+  return strncmp(s, prefix, N - 1) == 0;
 }
 
-static std::unordered_set<std::string> kValidNfTags = {
-    "nf.node",    "nf.cluster", "nf.app",           "nf.asg",    "nf.stack",
-    "nf.ami",     "nf.vmtype",  "nf.zone",          "nf.region", "nf.account",
-    "nf.country", "nf.task",    "nf.country.rollup"};
-
-static bool is_user_key_invalid(const std::string& k) noexcept {
-  if (StartsWith(k, "atlas.")) {
-    return k != "atlas.dstype" && k != "atlas.legacy";
-  }
-
-  if (StartsWith(k, "nf.")) {
-    return kValidNfTags.find(k) == kValidNfTags.end();
-  }
+static bool is_key_restricted(const char* k) noexcept {
+  return starts_with(k, "nf.") || starts_with(k, "atlas.");
+}
 
-  return false;
+// keys in the restricted namespaces that users are allowed to set
+static const std::unordered_set<util::StrRef>& allowed_restricted_keys() {
+  static const auto* keys = new std::unordered_set<util::StrRef>{
+      intern_str("atlas.dstype"), intern_str("atlas.legacy"),
+      intern_str("nf.node"),      intern_str("nf.cluster"),
+      intern_str("nf.app"),       intern_str("nf.asg"),
+      intern_str("nf.stack"),     intern_str("nf.ami"),
+      intern_str("nf.vmtype"),    intern_str("nf.zone"),
+      intern_str("nf.region"),    intern_str("nf.account"),
+      intern_str("nf.country"),   intern_str("nf.task"),
+      intern_str("nf.country.rollup")};
+  return *keys;
 }
 
 bool IsValid(const Tags& tags) noexcept {
   std::string err_msg;
   size_t user_tags = 0;
-  auto logger = util::Logger();
   auto name_seen = false;
 
+  static const auto name_ref = intern_str("name");
+  const auto& allowed_keys = allowed_restricted_keys();
   for (const auto& kv : tags) {
-    const auto& k_ref = kv.first;
-    const auto& v_ref = kv.second;
-    const std::string k = k_ref.get();
-    const std::string v = v_ref.get();
-
-    if (k.empty() || v.empty()) {
+    const char* k = kv.first.get();
+    const char* v = kv.second.get();
+    if (*k == '\0' || *v == '\0') {
       err_msg = "Tag keys or values cannot be empty";
       goto invalid;
     }
 
-    if (k == "name") {
+    auto v_length = strlen(v);
+    if (kv.first == name_ref) {
       name_seen = true;
       ++user_tags;
-      if (v.length() > MAX_NAME_LENGTH) {
+      if (v_length > MAX_NAME_LENGTH) {
         std::ostringstream os;
-        os << "value for name exceeds length limit (" << v.length() << ">"
+        os << "value for name exceeds length limit (" << v_length << ">"
            << MAX_NAME_LENGTH << ")";
         err_msg = os.str();
         goto invalid;
@@ -67,10 +68,11 @@ bool IsValid(const Tags& tags) noexcept {
       continue;
     }
 
-    if (k.length() > MAX_KEY_LENGTH || v.length() > MAX_VAL_LENGTH) {
+    auto k_length = strlen(k);
+    if (k_length > MAX_KEY_LENGTH || v_length > MAX_VAL_LENGTH) {
       std::ostringstream os;
-      os << "Tag " << k << "=" << v << " exceeds length limits (" << k.length()
-         << "-" << MAX_KEY_LENGTH << ", " << v.length() << "-" << MAX_VAL_LENGTH
+      os << "Tag " << k << "=" << v << " exceeds length limits (" << k_length
+         << "-" << MAX_KEY_LENGTH << ", " << v_length << "-" << MAX_VAL_LENGTH
          << ")";
       err_msg = os.str();
       goto invalid;
@@ -78,10 +80,8 @@ bool IsValid(const Tags& tags) noexcept {
 
     if (!is_key_restricted(k)) {
       ++user_tags;
-    }
-
-    if (is_user_key_invalid(k)) {
-      err_msg = k + " is using a reserved namespace";
+    } else if (allowed_keys.count(kv.first) == 0) {
+      err_msg = std::string(k) + " is using a reserved namespace";
       goto invalid;
     }
   }
@@ -105,10 +105,48 @@ bool IsValid(const Tags& tags) noexcept {
 invalid:
   std::ostringstream os;
   dump_tags(os, tags);
-  logger->warn("Invalid metric {} - {}", os.str(), err_msg);
+  util::Logger()->warn("Invalid metric {} - {}", os.str(), err_msg);
   return false;
 }
 
+ValidationCache::~ValidationCache() {
+  for (const auto& verdict : verdicts_) {
+    verdict.first.release_refs();
+  }
+}
+
+bool ValidationCache::IsValid(const Tags& tags) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = verdicts_.find(tags);
+  if (it == verdicts_.end()) {
+    auto valid = validation::IsValid(tags);
+    // verdicts can outlive the series they were computed for
+    Tags key(tags);
+    key.acquire_refs();
+    it = verdicts_.emplace(std::move(key), Verdict{valid, generation_}).first;
+  }
+  it->second.last_used = generation_;
+  return it->second.valid;
+}
+
+void ValidationCache::Rotate() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = verdicts_.begin(); it != verdicts_.end();) {
+    if (it->second.last_used != generation_) {
+      it->first.release_refs();
+      it = verdicts_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  ++generation_;
+}
+
+size_t ValidationCache::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return verdicts_.size();
+}
+
 }  // namespace validation
 }  // namespace meter
 }  // namespace atlas
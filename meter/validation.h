@@ -1,6 +1,8 @@
 #pragma once
 
 #include "id.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace atlas {
 namespace meter {
@@ -10,6 +12,32 @@ namespace validation {
 /// backends. It assumes we will fix invalid characters
 bool IsValid(const Tags& tags) noexcept;
 
+/// Remembers the verdicts for tags that were already validated, so only new
+/// series pay for validation. Verdicts that were not used since the previous
+/// call to Rotate are dropped, so old tags are not kept alive
+class ValidationCache {
+ public:
+  ValidationCache() = default;
+  ValidationCache(const ValidationCache&) = delete;
+  ValidationCache& operator=(const ValidationCache&) = delete;
+  ~ValidationCache();
+
+  bool IsValid(const Tags& tags);
+
+  void Rotate();
+
+  size_t size() const;
+
+ private:
+  struct Verdict {
+    bool valid;
+    uint32_t last_used;
+  };
+  mutable std::mutex mutex_;
+  std::unordered_map<Tags, Verdict> verdicts_;
+  uint32_t generation_ = 0;
+};
+
 }  // namespace validation
 }  // namespace meter
 }  // namespace atlas
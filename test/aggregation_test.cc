@@ -0,0 +1,57 @@
+#include "../interpreter/aggregation.h"
+#include <gtest/gtest.h>
+
+using atlas::interpreter::Aggregate;
+using atlas::interpreter::aggregation::Reduce;
+
+static constexpr auto kNaN = std::numeric_limits<double>::quiet_NaN();
+
+TEST(Aggregation, ReduceEmpty) {
+  EXPECT_TRUE(std::isnan(Reduce(Aggregate::SUM, nullptr, 0)));
+  EXPECT_TRUE(std::isnan(Reduce(Aggregate::AVG, nullptr, 0)));
+  EXPECT_TRUE(std::isnan(Reduce(Aggregate::MIN, nullptr, 0)));
+  EXPECT_TRUE(std::isnan(Reduce(Aggregate::MAX, nullptr, 0)));
+  EXPECT_DOUBLE_EQ(0.0, Reduce(Aggregate::COUNT, nullptr, 0));
+}
+
+TEST(Aggregation, ReduceAllNaN) {
+  std::vector<double> vs{kNaN, kNaN, kNaN, kNaN, kNaN};
+  EXPECT_TRUE(std::isnan(Reduce(Aggregate::SUM, vs.data(), vs.size())));
+  EXPECT_TRUE(std::isnan(Reduce(Aggregate::MAX, vs.data(), vs.size())));
+  EXPECT_DOUBLE_EQ(0.0, Reduce(Aggregate::COUNT, vs.data(), vs.size()));
+}
+
+TEST(Aggregation, ReduceSkipsNaN) {
+  // not a multiple of the number of lanes, so the tail loop gets exercised
+  std::vector<double> vs{1.0, kNaN, -3.0, 4.0, kNaN, 10.0, 2.0};
+  EXPECT_DOUBLE_EQ(14.0, Reduce(Aggregate::SUM, vs.data(), vs.size()));
+  EXPECT_DOUBLE_EQ(5.0, Reduce(Aggregate::COUNT, vs.data(), vs.size()));
+  EXPECT_DOUBLE_EQ(2.8, Reduce(Aggregate::AVG, vs.data(), vs.size()));
+  EXPECT_DOUBLE_EQ(-3.0, Reduce(Aggregate::MIN, vs.data(), vs.size()));
+  EXPECT_DOUBLE_EQ(10.0, Reduce(Aggregate::MAX, vs.data(), vs.size()));
+}
+
+TEST(Aggregation, ApplyAcrossChunks) {
+  using atlas::interpreter::TagsValuePair;
+  using atlas::interpreter::TagsValuePairs;
+  using atlas::meter::Tags;
+  namespace aggregation = atlas::interpreter::aggregation;
+  namespace query = atlas::interpreter::query;
+
+  // more matching values than fit in one chunk of the column
+  TagsValuePairs pairs;
+  Tags even{{"name", "even"}};
+  Tags odd{{"name", "odd"}};
+  for (auto i = 0; i < 1000; ++i) {
+    pairs.push_back(TagsValuePair{i % 2 == 0 ? even : odd,
+                                  i % 10 == 0 ? kNaN : static_cast<double>(i)});
+  }
+  std::shared_ptr<atlas::interpreter::Query> filter =
+      query::eq("name", "even");
+  // 0, 2, ..., 998 without the multiples of 10
+  EXPECT_DOUBLE_EQ(aggregation::sum(filter)->Apply(pairs).value,
+                   249500.0 - 49500.0);
+  EXPECT_DOUBLE_EQ(aggregation::count(filter)->Apply(pairs).value, 400.0);
+  EXPECT_DOUBLE_EQ(aggregation::min(filter)->Apply(pairs).value, 2.0);
+  EXPECT_DOUBLE_EQ(aggregation::max(filter)->Apply(pairs).value, 998.0);
+}
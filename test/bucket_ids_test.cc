@@ -0,0 +1,25 @@
+#include "../meter/bucket_ids.h"
+#include <gtest/gtest.h>
+
+using atlas::meter::BucketFunction;
+using atlas::meter::BucketIds;
+using atlas::meter::Id;
+using atlas::meter::Tags;
+using atlas::util::intern_str;
+
+TEST(BucketIds, OnePerBucket) {
+  auto id = std::make_shared<Id>("foo", Tags{{"k", "v"}});
+  BucketFunction f{{{"fast", 10}, {"ok", 100}}, "slow"};
+  BucketIds ids{id, f};
+  const auto& fast = ids.For(f.IndexOf(1));
+  EXPECT_EQ(fast, ids.For(f.IndexOf(10)));
+  EXPECT_NE(fast, ids.For(f.IndexOf(11)));
+
+  EXPECT_STREQ(fast->Name(), "foo");
+  const auto& tags = fast->GetTags();
+  EXPECT_EQ(tags.size(), 2u);
+  EXPECT_EQ(tags.at(intern_str("bucket")), intern_str("fast"));
+  EXPECT_EQ(tags.at(intern_str("k")), intern_str("v"));
+  EXPECT_EQ(ids.For(f.IndexOf(1000))->GetTags().at(intern_str("bucket")),
+            intern_str("slow"));
+}
@@ -0,0 +1,137 @@
+#include "../util/dump_writer.h"
+#include <algorithm>
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+using atlas::util::DumpWriter;
+
+static std::shared_ptr<const std::string> shared(std::string payload) {
+  return std::make_shared<const std::string>(std::move(payload));
+}
+
+class DumpDir {
+ public:
+  DumpDir() {
+    char name[] = "/tmp/dump_writer_test.XXXXXX";
+    dir_ = mkdtemp(name);
+  }
+  ~DumpDir() {
+    for (const auto& f : Files()) {
+      unlink((dir_ + "/" + f).c_str());
+    }
+    rmdir(dir_.c_str());
+  }
+  const std::string& name() const { return dir_; }
+
+  std::vector<std::string> Files() const {
+    std::vector<std::string> files;
+    auto d = opendir(dir_.c_str());
+    if (d == nullptr) {
+      return files;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(d)) != nullptr) {
+      std::string f{entry->d_name};
+      if (f != "." && f != "..") {
+        files.push_back(f);
+      }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+
+ private:
+  std::string dir_;
+};
+
+static std::string ReadGzip(const std::string& file_name) {
+  std::string contents;
+  auto fd = gzopen(file_name.c_str(), "rb");
+  if (fd == nullptr) {
+    return contents;
+  }
+  char buf[4096];
+  int n;
+  while ((n = gzread(fd, buf, sizeof buf)) > 0) {
+    contents.append(buf, static_cast<size_t>(n));
+  }
+  gzclose(fd);
+  return contents;
+}
+
+TEST(DumpWriter, Write) {
+  DumpDir dir;
+  DumpWriter writer{dir.name(), 1 << 20, 10, 1 << 20};
+  ASSERT_TRUE(writer.Dump("main_", ".json", shared("{\"a\":1}")));
+  writer.Flush();
+
+  auto files = dir.Files();
+  ASSERT_EQ(files.size(), 1u);
+  const auto& f = files[0];
+  EXPECT_EQ(f.compare(0, 5, "main_"), 0) << f;
+  EXPECT_EQ(f.substr(f.size() - 8), ".json.gz") << f;
+  EXPECT_EQ(ReadGzip(dir.name() + "/" + f), "{\"a\":1}");
+}
+
+TEST(DumpWriter, RotateByCount) {
+  DumpDir dir;
+  DumpWriter writer{dir.name(), 1 << 20, 3, 1 << 20};
+  for (auto i = 0; i < 5; ++i) {
+    ASSERT_TRUE(writer.Dump("a_", ".json", shared(std::to_string(i))));
+    ASSERT_TRUE(writer.Dump("b_", ".json", shared(std::to_string(i))));
+  }
+  writer.Flush();
+
+  // three files per prefix, the latest ones. The sequence number keeps names
+  // unique and in order within the same millisecond
+  auto files = dir.Files();
+  ASSERT_EQ(files.size(), 6u);
+  std::vector<std::string> contents;
+  for (const auto& f : files) {
+    contents.push_back(ReadGzip(dir.name() + "/" + f));
+  }
+  std::vector<std::string> a{contents.begin(), contents.begin() + 3};
+  std::sort(a.begin(), a.end());
+  EXPECT_EQ(a, (std::vector<std::string>{"2", "3", "4"}));
+}
+
+TEST(DumpWriter, RotateBySize) {
+  DumpDir dir;
+  // a gzip file is at least 20 bytes, so only the latest one is kept
+  DumpWriter writer{dir.name(), 1 << 20, 100, 10};
+  for (auto i = 0; i < 5; ++i) {
+    ASSERT_TRUE(writer.Dump("a_", ".json", shared(std::to_string(i))));
+  }
+  writer.Flush();
+
+  auto files = dir.Files();
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(ReadGzip(dir.name() + "/" + files[0]), "4");
+}
+
+TEST(DumpWriter, DropWhenFull) {
+  DumpDir dir;
+  DumpWriter writer{dir.name(), 16, 10, 1 << 20};
+  EXPECT_FALSE(writer.Dump("a_", ".json", shared(std::string(17, 'x'))));
+  writer.Flush();
+  EXPECT_TRUE(dir.Files().empty());
+
+  EXPECT_TRUE(writer.Dump("a_", ".json", shared(std::string(16, 'x'))));
+  writer.Flush();
+  EXPECT_EQ(dir.Files().size(), 1u);
+}
+
+TEST(DumpWriter, WritesQueuedOnDestruction) {
+  DumpDir dir;
+  {
+    DumpWriter writer{dir.name(), 1 << 20, 100, 1 << 20};
+    for (auto i = 0; i < 10; ++i) {
+      ASSERT_TRUE(writer.Dump("a_", ".json", shared(std::to_string(i))));
+    }
+  }
+  EXPECT_EQ(dir.Files().size(), 10u);
+}
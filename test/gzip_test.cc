@@ -0,0 +1,128 @@
+#include "../meter/payload_encoder.h"
+#include "../util/gzip.h"
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+
+using atlas::util::GzipCompressor;
+using atlas::util::GzipParams;
+using atlas::util::gzip_uncompress;
+
+static std::string payload(int n) {
+  std::string res;
+  for (auto i = 0; i < n; ++i) {
+    res += R"({"tags":{"name":"requests","id":")" + std::to_string(i) +
+           R"("},"start":1,"value":)" + std::to_string(i * 1.1) + "},";
+  }
+  return res;
+}
+
+static std::string uncompress(const GzipCompressor& compressor) {
+  std::string res(1 << 20, '\0');
+  uLongf size = res.size();
+  auto err = gzip_uncompress(reinterpret_cast<Bytef*>(&res[0]), &size,
+                             compressor.data(), compressor.size());
+  EXPECT_EQ(err, Z_OK);
+  res.resize(size);
+  return res;
+}
+
+TEST(Gzip, Reuse) {
+  GzipCompressor compressor;
+  for (auto n : {1000, 10, 0, 5000}) {
+    auto p = payload(n);
+    ASSERT_EQ(compressor.Compress(reinterpret_cast<const Bytef*>(p.data()),
+                                  p.size(), GzipParams{}),
+              Z_OK);
+    EXPECT_EQ(uncompress(compressor), p);
+  }
+}
+
+TEST(Gzip, Options) {
+  auto p = payload(1000);
+  auto source = reinterpret_cast<const Bytef*>(p.data());
+  GzipCompressor compressor;
+  std::vector<std::pair<int, int>> levels_strategies{
+      {1, Z_DEFAULT_STRATEGY}, {9, Z_DEFAULT_STRATEGY},
+      {6, Z_FILTERED},         {6, Z_RLE},
+      {6, Z_HUFFMAN_ONLY},     {0, Z_DEFAULT_STRATEGY}};
+  size_t fast = 0, best = 0;
+  for (const auto& level_strategy : levels_strategies) {
+    GzipParams options;
+    options.level = level_strategy.first;
+    options.strategy = level_strategy.second;
+    ASSERT_EQ(compressor.Compress(source, p.size(), options), Z_OK);
+    EXPECT_EQ(uncompress(compressor), p);
+    if (options.level == 1) {
+      fast = compressor.size();
+    } else if (options.level == 9) {
+      best = compressor.size();
+    }
+  }
+  EXPECT_LT(best, fast);
+  // not compressed at all
+  EXPECT_GT(compressor.size(), p.size());
+}
+
+// 10k measurements shaped like the ones the main publish cluster gets: a few
+// dozen metric names, with statistic, status and endpoint tags
+static atlas::interpreter::TagsValuePairs publish_measurements() {
+  using atlas::interpreter::TagsValuePair;
+  using atlas::meter::Tags;
+  static const char* kStats[] = {"count", "totalTime", "totalOfSquares",
+                                 "max"};
+  atlas::interpreter::TagsValuePairs ms;
+  for (auto i = 0; i < 10000; ++i) {
+    Tags tags{{"atlas.dstype", "rate"},
+              {"nf.app", "payments"},
+              {"nf.cluster", "payments-main"},
+              {"nf.node", "i-0123456789abcdef0"}};
+    tags.add("name", ("server.requests." + std::to_string(i % 40)).c_str());
+    tags.add("statistic", kStats[i % 4]);
+    tags.add("status", std::to_string(200 + (i / 4) % 5 * 100).c_str());
+    tags.add("endpoint", ("/api/v1/resource" + std::to_string(i % 97)).c_str());
+    ms.push_back(TagsValuePair{tags, i * 0.37});
+  }
+  return ms;
+}
+
+// Not run by default. Run with --gtest_also_run_disabled_tests to compare
+// compressed sizes and throughput when changing the gzip defaults
+TEST(Gzip, DISABLED_LevelThroughput) {
+  using atlas::meter::MeasurementsToBinary;
+  using atlas::meter::MeasurementsToJson;
+  using clock = std::chrono::steady_clock;
+  auto ms = publish_measurements();
+  int64_t added;
+  auto json = MeasurementsToJson(0, atlas::meter::kEmptyTags, ms.begin(),
+                                 ms.end(), nullptr, &added);
+  auto binary = MeasurementsToBinary(0, atlas::meter::kEmptyTags, ms.begin(),
+                                     ms.end(), nullptr, &added);
+
+  std::vector<std::pair<int, int>> levels_strategies{
+      {1, Z_DEFAULT_STRATEGY}, {3, Z_DEFAULT_STRATEGY},
+      {6, Z_DEFAULT_STRATEGY}, {9, Z_DEFAULT_STRATEGY},
+      {1, Z_FILTERED},         {6, Z_FILTERED},
+      {6, Z_RLE},              {6, Z_HUFFMAN_ONLY}};
+  const int kRuns = 20;
+  GzipCompressor compressor;
+  for (const auto* payload : {&json, &binary}) {
+    printf("%s payload, %zu bytes\n", payload == &json ? "json" : "binary",
+           payload->size());
+    auto source = reinterpret_cast<const Bytef*>(payload->data());
+    for (const auto& level_strategy : levels_strategies) {
+      GzipParams options;
+      options.level = level_strategy.first;
+      options.strategy = level_strategy.second;
+      auto start = clock::now();
+      for (auto i = 0; i < kRuns; ++i) {
+        ASSERT_EQ(compressor.Compress(source, payload->size(), options), Z_OK);
+      }
+      auto elapsed = std::chrono::duration<double>(clock::now() - start);
+      auto mb_per_sec = payload->size() * kRuns / elapsed.count() / 1e6;
+      printf("  level %d strategy %d: %8zu bytes %7.1f MB/s\n", options.level,
+             options.strategy, compressor.size(), mb_per_sec);
+    }
+  }
+}
@@ -6,6 +6,7 @@
 #include <sys/types.h>
 #include <zlib.h>
 
+#include "../meter/payload_encoder.h"
 #include "../util/gzip.h"
 #include "../util/http.h"
 #include "../util/logger.h"
@@ -265,6 +266,51 @@ TEST(HttpTest, Post) {
   EXPECT_EQ(post_data, body_str);
 }
 
+TEST(HttpTest, PostBinaryPayload) {
+  using atlas::meter::Tags;
+  using atlas::util::http;
+
+  http_server server;
+  server.start();
+  auto port = server.get_port();
+  ASSERT_TRUE(port > 0) << "Port = " << port;
+
+  atlas::interpreter::TagsValuePairs ms;
+  for (auto i = 0; i < 10; ++i) {
+    ms.push_back({Tags{{"name", "foo"}, {"id", std::to_string(i).c_str()}},
+                  static_cast<double>(i)});
+  }
+  const auto& encoder =
+      atlas::meter::EncoderFor(atlas::util::PayloadFormat::Binary);
+  int64_t added;
+  auto payload = encoder.Encode(1, atlas::meter::kEmptyTags, ms.begin(),
+                                ms.end(), nullptr, &added);
+
+  http client;
+  auto url = "http://localhost:" + std::to_string(port) + "/publish";
+  client.post(url, 1, 1, encoder.ContentType(), payload.data(),
+              payload.size());
+  server.stop();
+
+  const auto& requests = server.get_requests();
+  ASSERT_EQ(requests.size(), 1);
+  const auto& r = requests[0];
+  EXPECT_EQ(r.get_header("Content-Type"), "application/x-atlas-binary");
+
+  char dest[8192];
+  size_t dest_len = sizeof dest;
+  auto res = atlas::util::gzip_uncompress((Bytef*)dest, &dest_len,
+                                          (const Bytef*)r.body(), r.size());
+  ASSERT_EQ(res, Z_OK);
+
+  rapidjson::Document decoded;
+  ASSERT_TRUE(atlas::meter::DecodeBinaryPayload(dest, dest_len, &decoded));
+  const auto& metrics = decoded["metrics"];
+  ASSERT_EQ(metrics.Size(), 10);
+  EXPECT_STREQ(metrics[3]["tags"]["id"].GetString(), "3");
+  EXPECT_DOUBLE_EQ(metrics[3]["value"].GetDouble(), 3.0);
+}
+
 TEST(HttpTest, Timeout) {
   using atlas::util::http;
   http_server server;
@@ -0,0 +1,92 @@
+#include "../meter/id.h"
+#include <gtest/gtest.h>
+#include <unordered_map>
+#include <unordered_set>
+
+using atlas::meter::Id;
+using atlas::meter::IdPtr;
+using atlas::meter::Tags;
+
+TEST(Id, Fingerprint) {
+  Id id{"name", Tags{{"k1", "v1"}, {"k2", "v2"}}};
+  Id same{"name", Tags{{"k2", "v2"}, {"k1", "v1"}}};
+  Id copy{id};
+  EXPECT_EQ(id.Fingerprint(), same.Fingerprint());
+  EXPECT_EQ(id.Fingerprint(), copy.Fingerprint());
+  EXPECT_EQ(id, same);
+
+  Id other_name{"other", Tags{{"k1", "v1"}, {"k2", "v2"}}};
+  Id swapped{"name", Tags{{"v1", "k1"}, {"v2", "k2"}}};
+  Id crossed{"name", Tags{{"k1", "v2"}, {"k2", "v1"}}};
+  EXPECT_NE(id.Fingerprint(), other_name.Fingerprint());
+  EXPECT_NE(id.Fingerprint(), swapped.Fingerprint());
+  EXPECT_NE(id.Fingerprint(), crossed.Fingerprint());
+}
+
+TEST(Id, CollisionRate) {
+  // ids that only differ in a couple of values, like a registry usually has
+  std::unordered_map<IdPtr, int> ids;
+  std::unordered_set<uint64_t> fingerprints;
+  for (auto i = 0; i < 100; ++i) {
+    for (auto j = 0; j < 200; ++j) {
+      auto id = std::make_shared<Id>(
+          "requests", Tags{{"status", std::to_string(i).c_str()},
+                           {"path", std::to_string(j).c_str()},
+                           {"nf.app", "app"}});
+      fingerprints.insert(id->Fingerprint());
+      ids[id] = i;
+    }
+  }
+  EXPECT_EQ(fingerprints.size(), 20000);
+  EXPECT_EQ(ids.size(), 20000);
+
+  size_t max_bucket = 0;
+  for (size_t b = 0; b < ids.bucket_count(); ++b) {
+    max_bucket = std::max(max_bucket, ids.bucket_size(b));
+  }
+  EXPECT_LE(max_bucket, 10);
+}
+
+TEST(Id, WithTag) {
+  using atlas::meter::Tag;
+  Id id{"name", Tags{{"k1", "v1"}}};
+  auto derived = id.WithTag(Tag::of("k2", "v2"));
+  EXPECT_EQ(*derived, (Id{"name", Tags{{"k1", "v1"}, {"k2", "v2"}}}));
+  EXPECT_EQ(id.GetTags().size(), 1);
+
+  // nothing changes, so the tags are shared
+  auto same = id.WithTag(Tag::of("k1", "v1"));
+  EXPECT_EQ(*same, id);
+  EXPECT_EQ(&same->GetTags(), &id.GetTags());
+
+  auto chained = id.WithTags({Tag::of("k2", "v2"), Tag::of("k1", "x")});
+  EXPECT_EQ(*chained,
+            *id.WithTag(Tag::of("k2", "v2"))->WithTag(Tag::of("k1", "x")));
+}
+
+TEST(Id, DerivedIds) {
+  using atlas::meter::Tag;
+  using atlas::util::intern_str;
+  Id id{"name", Tags{{"k1", "v1"}, {"k2", "v2"}}};
+  auto replaced = id.WithTag(Tag::of("k1", "x"));
+  Id flat{"name", Tags{{"k1", "x"}, {"k2", "v2"}}};
+  EXPECT_EQ(replaced->Fingerprint(), flat.Fingerprint());
+  EXPECT_EQ(*replaced, flat);
+  EXPECT_EQ(flat, *replaced);
+  EXPECT_TRUE(replaced->HasTag(intern_str("k2")));
+  EXPECT_FALSE(replaced->HasTag(intern_str("k3")));
+  EXPECT_EQ(replaced->GetTags(), flat.GetTags());
+
+  // deriving from derived ids, past the depth at which they are flattened
+  auto derived = std::make_shared<Id>(id);
+  auto expected = id.GetTags();
+  for (auto i = 0; i < 20; ++i) {
+    auto key = "d" + std::to_string(i);
+    derived = derived->WithTag(Tag::of(key, "v"));
+    expected.add(key.c_str(), "v");
+  }
+  Id same{"name", expected};
+  EXPECT_EQ(derived->Fingerprint(), same.Fingerprint());
+  EXPECT_EQ(*derived, same);
+  EXPECT_EQ(derived->GetTags(), expected);
+}
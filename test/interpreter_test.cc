@@ -64,6 +64,20 @@ TEST(Interpreter, SplitWithTrim) {
   result.clear();
 }
 
+TEST(Interpreter, TokenizeSlices) {
+  const std::string program{" name ,(, a ,b,), :in"};
+  Tokens tokens;
+  tokenize(program, &tokens);
+
+  Strings expected{"name", "(", "a", "b", ")", ":in"};
+  ASSERT_EQ(expected.size(), tokens.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    const auto& token = tokens[i];
+    EXPECT_GE(token.data, program.data());
+    EXPECT_EQ(expected[i], std::string(token.data, token.size));
+  }
+}
+
 static Tags common_tags{{"nf.node", "i-1234"},
                         {"nf.cluster", "foo-main"},
                         {"nf.asg", "foo-main-v001"}};
@@ -92,6 +106,27 @@ TEST(Interpreter, EqualQuery) {
   ASSERT_FALSE(query->Matches(not_sps));
 }
 
+TEST(Interpreter, InQuery) {
+  auto context = exec("name,(,sps,sps2,),:in");
+  ASSERT_EQ(1, context->StackSize());
+
+  auto expr = context->PopExpression();
+  ASSERT_TRUE(expression::IsQuery(*expr));
+  auto query = std::static_pointer_cast<Query>(expr);
+
+  Tags sps{{"name", "sps"}};
+  EXPECT_TRUE(query->Matches(sps));
+  Tags sps2{{"name", "sps2"}};
+  EXPECT_TRUE(query->Matches(sps2));
+  Tags other{{"name", "sps3"}};
+  EXPECT_FALSE(query->Matches(other));
+}
+
+TEST(Interpreter, UnknownWord) {
+  auto context = exec("name,sps,:foo");
+  EXPECT_EQ(2, context->StackSize());
+}
+
 TEST(Interpreter, RegexQuery) {
   auto context = exec("id,sps,:re");
   ASSERT_EQ(1, context->StackSize());
@@ -167,6 +202,36 @@ TEST(Interpreter, GroupBy) {
   }
 }
 
+TEST(Interpreter, GroupByAggregates) {
+  auto measurements = get_measurements();
+  Tags nan_tags{{"name", "name1"}, {"k1", "v1"}, {"k2", "w2"}};
+  measurements.push_back(
+      TagsValuePair{nan_tags, std::numeric_limits<double>::quiet_NaN()});
+
+  Tags t1{{"name", "name1"}, {"k1", "v1"}};
+  Tags t2{{"name", "name1"}, {"k1", "v2"}};
+  auto check = [&measurements, &t1, &t2](const std::string& expr, double v1,
+                                         double v2) {
+    auto context = exec(expr);
+    auto by = std::static_pointer_cast<MultipleResults>(
+        context->PopExpression());
+    auto res = by->Apply(measurements);
+    ASSERT_EQ(res.size(), 2);
+    for (const auto& r : res) {
+      if (r.tags == t1) {
+        EXPECT_DOUBLE_EQ(r.value, v1) << expr;
+      } else {
+        EXPECT_EQ(r.tags, t2);
+        EXPECT_DOUBLE_EQ(r.value, v2) << expr;
+      }
+    }
+  };
+  check("name,name1,:eq,:max,(,k1,),:by", 3.0, 2.0);
+  check("name,name1,:eq,:min,(,k1,),:by", 1.0, 2.0);
+  check("name,name1,:eq,:avg,(,k1,),:by", 2.0, 2.0);
+  check("name,name1,:eq,:count,(,k1,),:by", 2.0, 1.0);
+}
+
 TEST(Interpreter, GroupByFiltering) {
   auto context = exec("name,name1,:eq,:count,(,k2,),:by");
   ASSERT_EQ(1, context->StackSize());
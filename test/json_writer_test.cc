@@ -0,0 +1,80 @@
+#include "../util/json.h"
+#include "../util/json_writer.h"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+
+using atlas::util::JsonWriter;
+
+static std::string rapidjson_str(const rapidjson::Document& doc) {
+  rapidjson::StringBuffer buffer;
+  return atlas::util::JsonGetString(buffer, doc);
+}
+
+TEST(JsonWriter, Structure) {
+  JsonWriter writer;
+  writer.StartObject();
+  writer.SafeString("tags");
+  writer.StartObject();
+  writer.EndObject();
+  writer.SafeString("metrics");
+  writer.StartArray();
+  for (auto i = 0; i < 2; ++i) {
+    writer.StartObject();
+    writer.SafeString("k");
+    writer.String("v");
+    writer.SafeString("n");
+    writer.Int64(-i);
+    writer.EndObject();
+  }
+  writer.StartArray();
+  writer.EndArray();
+  writer.EndArray();
+  writer.EndObject();
+  EXPECT_EQ(writer.Result(),
+            R"({"tags":{},"metrics":[{"k":"v","n":0},{"k":"v","n":-1},[]]})");
+}
+
+TEST(JsonWriter, Escapes) {
+  const char s[] = "a\"b\\c\n\t\x01/\xc3\xa9";
+  rapidjson::Document doc{rapidjson::kArrayType};
+  doc.PushBack(rapidjson::StringRef(s), doc.GetAllocator());
+
+  JsonWriter writer;
+  writer.StartArray();
+  writer.String(s);
+  writer.EndArray();
+  EXPECT_EQ(writer.Result(), rapidjson_str(doc));
+}
+
+TEST(JsonWriter, Doubles) {
+  std::mt19937_64 rng{42};
+  std::uniform_real_distribution<double> small{-1e3, 1e3};
+  std::vector<double> values{0.0,
+                             -0.0,
+                             1.0,
+                             0.1,
+                             1e21,
+                             1e-7,
+                             123456789012.0,
+                             std::numeric_limits<double>::max(),
+                             std::numeric_limits<double>::min(),
+                             std::nan(""),
+                             std::numeric_limits<double>::infinity(),
+                             -std::numeric_limits<double>::infinity()};
+  for (auto i = 0; i < 1000; ++i) {
+    values.push_back(small(rng));
+    values.push_back(small(rng) * 1e100);
+  }
+
+  rapidjson::Document doc{rapidjson::kArrayType};
+  JsonWriter writer;
+  writer.StartArray();
+  for (auto v : values) {
+    doc.PushBack(v, doc.GetAllocator());
+    writer.Double(v);
+  }
+  writer.EndArray();
+  EXPECT_EQ(writer.Result(), rapidjson_str(doc));
+}
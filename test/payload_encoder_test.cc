@@ -0,0 +1,118 @@
+#include "../meter/payload_encoder.h"
+#include "../util/json.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+using atlas::interpreter::TagsValuePair;
+using atlas::interpreter::TagsValuePairs;
+using atlas::meter::DecodeBinaryPayload;
+using atlas::meter::EncoderFor;
+using atlas::meter::MeasurementsToBinary;
+using atlas::meter::MeasurementsToJson;
+using atlas::meter::Tags;
+using atlas::meter::kEmptyTags;
+using atlas::util::PayloadFormat;
+
+static TagsValuePairs measurements() {
+  TagsValuePairs ms;
+  for (auto i = 0; i < 100; ++i) {
+    Tags tags{{"name", "requests"}, {"nf.app", "foo"}, {"status", "200"}};
+    tags.add("path", ("/p" + std::to_string(i % 7)).c_str());
+    tags.add("bad chars", "a b~c");
+    ms.push_back(TagsValuePair{tags, i * 1.1});
+  }
+  return ms;
+}
+
+TEST(PayloadEncoder, BinaryMatchesJson) {
+  auto ms = measurements();
+  ms.push_back(TagsValuePair{Tags{{"name", "nan"}}, std::nan("")});
+
+  int64_t json_added, binary_added;
+  Tags common{{"nf.app", "foo"}};
+  auto json = MeasurementsToJson(42, common, ms.begin(), ms.end(), nullptr,
+                                 &json_added);
+  auto binary = MeasurementsToBinary(42, common, ms.begin(), ms.end(), nullptr,
+                                     &binary_added);
+  EXPECT_EQ(json_added, 100);
+  EXPECT_EQ(binary_added, json_added);
+  // repeated tags are only sent once
+  EXPECT_LT(binary.size() * 3, json.size());
+
+  rapidjson::Document decoded;
+  ASSERT_TRUE(DecodeBinaryPayload(binary.data(), binary.size(), &decoded));
+  rapidjson::StringBuffer buffer;
+  EXPECT_EQ(json, atlas::util::JsonGetString(buffer, decoded));
+}
+
+TEST(PayloadEncoder, Malformed) {
+  auto ms = measurements();
+  int64_t added;
+  auto binary = MeasurementsToBinary(1, kEmptyTags, ms.begin(), ms.end(),
+                                     nullptr, &added);
+
+  rapidjson::Document decoded;
+  for (size_t size = 0; size < binary.size(); ++size) {
+    EXPECT_FALSE(DecodeBinaryPayload(binary.data(), size, &decoded)) << size;
+  }
+  auto trailing = binary + "x";
+  EXPECT_FALSE(DecodeBinaryPayload(trailing.data(), trailing.size(), &decoded));
+  auto bad_magic = binary;
+  bad_magic[0] = 'X';
+  EXPECT_FALSE(
+      DecodeBinaryPayload(bad_magic.data(), bad_magic.size(), &decoded));
+}
+
+TEST(PayloadEncoder, EncoderFor) {
+  auto ms = measurements();
+  auto first = ms.begin();
+  auto last = ms.end();
+  int64_t added;
+  const auto& json = EncoderFor(PayloadFormat::Json);
+  EXPECT_STREQ(json.ContentType(), "Content-Type: application/json");
+  EXPECT_EQ(json.Encode(1, kEmptyTags, first, last, nullptr, &added),
+            MeasurementsToJson(1, kEmptyTags, first, last, nullptr, &added));
+
+  const auto& binary = EncoderFor(PayloadFormat::Binary);
+  EXPECT_STREQ(binary.ContentType(),
+               "Content-Type: application/x-atlas-binary");
+  EXPECT_EQ(binary.Encode(1, kEmptyTags, first, last, nullptr, &added),
+            MeasurementsToBinary(1, kEmptyTags, first, last, nullptr, &added));
+}
+
+TEST(PayloadEncoder, CommonTags) {
+  Tags common{{"nf.app", "foo"}, {"nf.node", "i-1"}, {"nf.zone", "a"}};
+  TagsValuePairs ms;
+  ms.push_back({Tags::Merge(common, Tags{{"name", "n1"}}), 1.0});
+  // a rollup dropped nf.node
+  Tags rolled_up{{"name", "n2"}, {"nf.app", "foo"}, {"nf.zone", "a"}};
+  ms.push_back({rolled_up, 2.0});
+  // overrides nf.zone
+  ms.push_back({Tags::Merge(Tags{{"nf.zone", "b"}}, common), 3.0});
+  // not sent, so it does not matter that it has no common tags
+  ms.push_back({Tags{{"name", "n4"}}, std::nan("")});
+
+  int64_t added;
+  auto json = MeasurementsToJson(1, common, ms.begin(), ms.end(), nullptr,
+                                 &added);
+  EXPECT_EQ(added, 3);
+  const char* expected =
+      R"({"tags":{"nf.app":"foo"},"metrics":[)"
+      R"({"tags":{"name":"n1","nf.node":"i-1","nf.zone":"a"},)"
+      R"("start":1,"value":1.0},)"
+      R"({"tags":{"name":"n2","nf.zone":"a"},"start":1,"value":2.0},)"
+      R"({"tags":{"nf.node":"i-1","nf.zone":"b"},"start":1,"value":3.0}]})";
+  // tags are sorted by address, so compare the documents
+  rapidjson::Document expected_doc;
+  expected_doc.Parse(expected);
+  rapidjson::Document json_doc;
+  json_doc.Parse(json.c_str());
+  EXPECT_TRUE(json_doc == expected_doc) << json;
+
+  auto binary = MeasurementsToBinary(1, common, ms.begin(), ms.end(), nullptr,
+                                     &added);
+  rapidjson::Document decoded;
+  ASSERT_TRUE(DecodeBinaryPayload(binary.data(), binary.size(), &decoded));
+  rapidjson::StringBuffer buffer;
+  EXPECT_EQ(json, atlas::util::JsonGetString(buffer, decoded));
+}
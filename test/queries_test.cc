@@ -163,6 +163,23 @@ TEST(Queries, In) {
   EXPECT_FALSE(in1->Matches(tags2));
 }
 
+TEST(Queries, InEquals) {
+  auto in1 = query::in("k", {intern_str("foo"), intern_str("bar")});
+  auto in2 = query::in("k", {intern_str("bar"), intern_str("foo")});
+  auto in3 = query::in("k", {intern_str("bar")});
+  EXPECT_TRUE(*in1 == *in2);
+  EXPECT_FALSE(*in1 == *in3);
+}
+
+TEST(Queries, RelopEqInterned) {
+  auto eq1 = query::eq("k", "bar");
+  auto eq2 = query::eq("k", std::string("ba") + "r");
+  EXPECT_TRUE(*eq1 == *eq2);
+
+  Tags interned{{intern_str("k"), intern_str(std::string("b") + "ar")}};
+  EXPECT_TRUE(eq2->Matches(interned));
+}
+
 TEST(Queries, True) {
   auto q = query::true_q();
   EXPECT_TRUE(q->Matches(tags));
@@ -0,0 +1,166 @@
+#include "../meter/retry_queue.h"
+#include "../util/http.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+using atlas::meter::RetryQueue;
+using atlas::util::SpillRing;
+
+static const char* kRingFile = "retry_queue_test.ring";
+
+namespace {
+std::shared_ptr<const std::string> shared(const char* payload) {
+  return std::make_shared<const std::string>(payload);
+}
+
+struct FakeServer {
+  int status = 503;
+  std::vector<std::string> received;
+
+  RetryQueue::Sender sender() {
+    return [this](const std::string& content_type, const std::string& payload) {
+      EXPECT_EQ(content_type, "ct");
+      if (status == 200) {
+        received.push_back(payload);
+      }
+      return status;
+    };
+  }
+};
+}  // namespace
+
+TEST(RetryQueue, ShouldRetry) {
+  EXPECT_TRUE(RetryQueue::ShouldRetry(503));
+  EXPECT_TRUE(RetryQueue::ShouldRetry(429));
+  EXPECT_TRUE(RetryQueue::ShouldRetry(atlas::util::http::kTransportError));
+  // rejected by the server
+  EXPECT_FALSE(RetryQueue::ShouldRetry(400));
+  EXPECT_FALSE(RetryQueue::ShouldRetry(413));
+  // failed before sending, so it would fail the same way on every replay
+  EXPECT_FALSE(RetryQueue::ShouldRetry(atlas::util::http::kLocalError));
+}
+
+TEST(RetryQueue, SharesPayload) {
+  RetryQueue queue;
+  auto payload = shared("p1");
+  queue.Add("ct", payload, 1, 1000);
+  EXPECT_EQ(payload.use_count(), 2);
+}
+
+TEST(RetryQueue, RetriesWithBackoff) {
+  RetryQueue queue;
+  FakeServer server;
+  auto sender = server.sender();
+  queue.Add("ct", shared("p1"), 10, 1000);
+  EXPECT_EQ(queue.size(), 1u);
+  EXPECT_EQ(queue.OldestMillis(), 1000);
+
+  // not due before half the initial backoff
+  auto res = queue.Run(sender, 1400);
+  EXPECT_EQ(res.sent + res.dropped, 0);
+
+  int64_t now = 1000;
+  while (queue.size() > 0 && now < 1000 + RetryQueue::kRetryWindowMillis) {
+    now += 500;
+    if (now > 10000) {
+      server.status = 200;
+    }
+    res = queue.Run(sender, now);
+  }
+  EXPECT_EQ(res.sent, 10);
+  EXPECT_EQ(server.received, std::vector<std::string>{"p1"});
+  EXPECT_EQ(queue.OldestMillis(), 0);
+}
+
+TEST(RetryQueue, DropsWithoutSpill) {
+  RetryQueue queue;
+  FakeServer server;
+  queue.Add("ct", shared("p1"), 10, 0);
+  auto res = queue.Run(server.sender(), RetryQueue::kRetryWindowMillis);
+  EXPECT_EQ(res.dropped, 10);
+  EXPECT_EQ(queue.size(), 0u);
+
+  // too many batches
+  RetryQueue::Result total;
+  for (size_t i = 0; i <= RetryQueue::kMaxBatches; ++i) {
+    total.dropped += queue.Add("ct", shared("p"), 1, 0).dropped;
+  }
+  EXPECT_EQ(total.dropped, 1);
+  EXPECT_EQ(queue.size(), RetryQueue::kMaxBatches);
+}
+
+TEST(RetryQueue, SpillAndReplay) {
+  unlink(kRingFile);
+  FakeServer server;
+  {
+    RetryQueue queue{SpillRing::Open(kRingFile, 1 << 16)};
+    queue.Add("ct", shared("p1"), 1, 1000);
+    queue.Add("ct", shared("p2"), 2, 2000);
+    auto res =
+        queue.Run(server.sender(), 2000 + RetryQueue::kRetryWindowMillis);
+    EXPECT_EQ(res.dropped, 0);
+    EXPECT_EQ(queue.size(), 0u);
+    EXPECT_EQ(queue.spilled(), 2u);
+    EXPECT_EQ(queue.OldestSpilledMillis(), 1000);
+    queue.Add("ct", shared("p3"), 3, 60000);
+    EXPECT_EQ(queue.SpillAll().dropped, 0);
+    EXPECT_EQ(queue.spilled(), 3u);
+  }
+
+  // spilled batches survive a restart, and are replayed once sends work
+  RetryQueue queue{SpillRing::Open(kRingFile, 1 << 16)};
+  EXPECT_EQ(queue.spilled(), 3u);
+  server.status = 200;
+  auto res = queue.Run(server.sender(), 70000);
+  EXPECT_EQ(res.sent, 0);
+  queue.RecordStatus(200);
+  res = queue.Run(server.sender(), 70000);
+  EXPECT_EQ(res.sent, 6);
+  EXPECT_EQ(server.received, (std::vector<std::string>{"p1", "p2", "p3"}));
+  EXPECT_EQ(queue.spilled(), 0u);
+
+  // too old to be accepted
+  queue.Add("ct", shared("old"), 4, 0);
+  queue.SpillAll();
+  res = queue.Run(server.sender(), RetryQueue::kMaxSpillAgeMillis + 1);
+  EXPECT_EQ(res.dropped, 4);
+  EXPECT_EQ(queue.spilled(), 0u);
+  unlink(kRingFile);
+}
+
+TEST(RetryQueue, DropsSpilledBatchThatKeepsFailing) {
+  unlink(kRingFile);
+  RetryQueue queue{SpillRing::Open(kRingFile, 1 << 16)};
+  queue.Add("ct", shared("bad"), 1, 1000);
+  queue.Add("ct", shared("good"), 2, 1000);
+  EXPECT_EQ(queue.SpillAll().dropped, 0);
+
+  std::vector<std::string> received;
+  auto sender = [&received](const std::string&, const std::string& payload) {
+    if (payload == "bad") {
+      return 503;
+    }
+    received.push_back(payload);
+    return 200;
+  };
+  RetryQueue::Result total;
+  for (auto i = 1; i <= RetryQueue::kMaxReplayAttempts; ++i) {
+    // other posts keep working
+    queue.RecordStatus(200);
+    auto res = queue.Run(sender, 2000);
+    total.sent += res.sent;
+    total.dropped += res.dropped;
+    EXPECT_EQ(res.sent, 0);
+    EXPECT_EQ(queue.spilled(),
+              i < RetryQueue::kMaxReplayAttempts ? 2u : 1u);
+  }
+  queue.RecordStatus(200);
+  auto res = queue.Run(sender, 2000);
+  total.sent += res.sent;
+  total.dropped += res.dropped;
+  EXPECT_EQ(total.dropped, 1);
+  EXPECT_EQ(total.sent, 2);
+  EXPECT_EQ(received, std::vector<std::string>{"good"});
+  EXPECT_EQ(queue.spilled(), 0u);
+  unlink(kRingFile);
+}
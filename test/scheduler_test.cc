@@ -0,0 +1,89 @@
+#include "../util/scheduler.h"
+#include <atomic>
+#include <gtest/gtest.h>
+
+using atlas::util::Scheduler;
+using std::chrono::milliseconds;
+
+TEST(Scheduler, RunsPeriodicTasks) {
+  std::atomic<int> fast{0};
+  std::atomic<int> slow{0};
+  std::atomic<int> lags{0};
+  auto observer = [&lags](const std::string&, Scheduler::Clock::duration lag) {
+    EXPECT_GE(lag.count(), 0);
+    ++lags;
+  };
+  Scheduler scheduler{2, observer};
+  auto start = Scheduler::Clock::now();
+  scheduler.SchedulePeriodic("fast", milliseconds(0), milliseconds(10),
+                             [&fast]() { ++fast; });
+  scheduler.Start();
+  scheduler.SchedulePeriodic("slow", milliseconds(50), milliseconds(1000),
+                             [&slow]() { ++slow; });
+  std::this_thread::sleep_for(milliseconds(200));
+  scheduler.Stop();
+  auto elapsed = Scheduler::Clock::now() - start;
+
+  // how many runs fit depends on how busy the machine is, but never more
+  // than one per period
+  auto runs = fast.load();
+  EXPECT_GE(runs, 1);
+  EXPECT_LE(runs, elapsed / milliseconds(10) + 1);
+  EXPECT_LE(slow, elapsed / milliseconds(1000) + 1);
+  EXPECT_EQ(lags, runs + slow);
+
+  // nothing runs after Stop returns
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_EQ(fast, runs);
+}
+
+TEST(Scheduler, RunsDoNotOverlap) {
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  Scheduler scheduler{4};
+  scheduler.SchedulePeriodic("busy", milliseconds(0), milliseconds(5), [&]() {
+    auto n = ++running;
+    if (n > max_running) {
+      max_running = n;
+    }
+    std::this_thread::sleep_for(milliseconds(20));
+    --running;
+  });
+  scheduler.Start();
+  std::this_thread::sleep_for(milliseconds(100));
+  scheduler.Stop();
+  EXPECT_EQ(max_running, 1);
+}
+
+TEST(Scheduler, NextAligned) {
+  using std::chrono::system_clock;
+  auto now = Scheduler::Clock::time_point{} + std::chrono::hours(1);
+  auto period = milliseconds(60000);
+  auto offset = milliseconds(5000);
+  auto at = [&](int64_t wall_millis) {
+    auto wall = system_clock::time_point{} + milliseconds(wall_millis);
+    return Scheduler::NextAligned(period, offset, now, wall) - now;
+  };
+
+  // 5s after the start of the next minute
+  EXPECT_EQ(at(600000), milliseconds(5000));
+  EXPECT_EQ(at(601000), milliseconds(4000));
+  // already past the offset in this minute
+  EXPECT_EQ(at(605000), milliseconds(60000));
+  EXPECT_EQ(at(630500), milliseconds(34500));
+  EXPECT_EQ(at(664999), milliseconds(1));
+}
+
+TEST(Scheduler, RunsAlignedTasks) {
+  std::atomic<int> runs{0};
+  Scheduler scheduler{1};
+  auto start = Scheduler::Clock::now();
+  scheduler.ScheduleAligned("aligned", milliseconds(0), milliseconds(20),
+                            [&runs]() { ++runs; });
+  scheduler.Start();
+  std::this_thread::sleep_for(milliseconds(200));
+  scheduler.Stop();
+  auto elapsed = Scheduler::Clock::now() - start;
+  EXPECT_GE(runs, 1);
+  EXPECT_LE(runs, elapsed / milliseconds(20) + 1);
+}
@@ -0,0 +1,56 @@
+#include "../util/snapshot.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using atlas::util::Snapshot;
+
+namespace {
+std::atomic<int> destroyed{0};
+
+struct Version {
+  explicit Version(int v) : a(v), b(v) {}
+  ~Version() {
+    a = -1;
+    b = -2;
+    ++destroyed;
+  }
+  int a;
+  int b;
+};
+}  // namespace
+
+TEST(Snapshot, ReadWhileUpdating) {
+  destroyed = 0;
+  constexpr int kUpdates = 2000;
+  {
+    Snapshot<Version> snapshot{std::unique_ptr<const Version>(new Version(0))};
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (auto i = 0; i < 4; ++i) {
+      readers.emplace_back([&snapshot, &done]() {
+        auto last = 0;
+        while (!done) {
+          auto v = snapshot.Read([](const Version& version) {
+            // a version deleted while we look at it would break this
+            EXPECT_EQ(version.a, version.b);
+            return version.a;
+          });
+          // versions only move forward
+          ASSERT_GE(v, last);
+          last = v;
+        }
+      });
+    }
+    for (auto i = 1; i <= kUpdates; ++i) {
+      snapshot.Update(std::unique_ptr<const Version>(new Version(i)));
+      EXPECT_EQ(snapshot.Current().a, i);
+    }
+    done = true;
+    for (auto& t : readers) {
+      t.join();
+    }
+    EXPECT_EQ(destroyed, kUpdates);
+  }
+  EXPECT_EQ(destroyed, kUpdates + 1);
+}
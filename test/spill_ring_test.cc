@@ -0,0 +1,77 @@
+#include "../util/spill_ring.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+using atlas::util::SpillRing;
+
+static const char* kRingFile = "spill_ring_test.ring";
+
+static std::string record(int i) {
+  return std::string(static_cast<size_t>(10 + i % 7),
+                     static_cast<char>('a' + i % 26));
+}
+
+TEST(SpillRing, PushPop) {
+  unlink(kRingFile);
+  auto ring = SpillRing::Open(kRingFile, 100);
+  ASSERT_TRUE(ring);
+  std::string r;
+  uint64_t seq;
+  EXPECT_FALSE(ring->Front(&r, &seq));
+
+  // wrap around many times, checking records come back in order
+  int pushed = 0, popped = 0;
+  for (auto round = 0; round < 100; ++round) {
+    while (ring->HasRoom(record(pushed).size())) {
+      auto rec = record(pushed++);
+      ASSERT_TRUE(ring->Push(rec.data(), rec.size()));
+    }
+    EXPECT_FALSE(ring->Push("x", 90));
+    EXPECT_LE(ring->bytes(), 100u);
+    auto to_pop = 1 + round % 3;
+    for (auto i = 0; i < to_pop && ring->Front(&r, &seq); ++i) {
+      EXPECT_EQ(r, record(popped++));
+      ring->Pop(seq);
+      // stale sequence numbers are ignored
+      ring->Pop(seq);
+    }
+    EXPECT_EQ(ring->size(), static_cast<size_t>(pushed - popped));
+  }
+  while (ring->Front(&r, &seq)) {
+    EXPECT_EQ(r, record(popped++));
+    ring->Pop(seq);
+  }
+  EXPECT_EQ(popped, pushed);
+  EXPECT_EQ(ring->bytes(), 0u);
+  EXPECT_FALSE(ring->Fits(97));
+  EXPECT_TRUE(ring->Fits(96));
+  unlink(kRingFile);
+}
+
+TEST(SpillRing, Reopen) {
+  unlink(kRingFile);
+  {
+    auto ring = SpillRing::Open(kRingFile, 1024);
+    ASSERT_TRUE(ring);
+    ring->Push("first", 5);
+    ring->Push("second", 6);
+  }
+  std::string r;
+  uint64_t seq;
+  {
+    auto ring = SpillRing::Open(kRingFile, 1024);
+    ASSERT_TRUE(ring);
+    EXPECT_EQ(ring->size(), 2u);
+    ASSERT_TRUE(ring->Front(&r, &seq));
+    EXPECT_EQ(r, "first");
+    ring->Pop(seq);
+  }
+  {
+    // a different capacity starts over
+    auto ring = SpillRing::Open(kRingFile, 2048);
+    ASSERT_TRUE(ring);
+    EXPECT_EQ(ring->size(), 0u);
+    EXPECT_FALSE(ring->Front(&r, &seq));
+  }
+  unlink(kRingFile);
+}
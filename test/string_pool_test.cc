@@ -0,0 +1,160 @@
+#include "../util/string_pool.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using atlas::util::StringPool;
+using atlas::util::StrRef;
+
+TEST(StringPool, Intern) {
+  StringPool pool;
+  auto& foo = pool.intern("foo");
+  EXPECT_STREQ(foo.get(), "foo");
+  EXPECT_EQ(pool.intern(std::string("foo").c_str()), foo);
+  EXPECT_EQ(pool.intern("foobar", 3), foo);
+  EXPECT_FALSE(pool.intern("bar") == foo);
+  EXPECT_EQ(pool.pool_size(), 2);
+  EXPECT_EQ(pool.alloc_size(), 8);
+}
+
+TEST(StringPool, Grows) {
+  StringPool pool;
+  std::vector<const char*> refs;
+  for (auto i = 0; i < 20000; ++i) {
+    refs.push_back(pool.intern(std::to_string(i).c_str()).get());
+  }
+  // big strings get their own allocation
+  std::string big(100000, 'x');
+  EXPECT_EQ(pool.intern(big.c_str()).get(), pool.intern(big.c_str()).get());
+
+  EXPECT_EQ(pool.pool_size(), 20001);
+  for (auto i = 0; i < 20000; ++i) {
+    auto s = std::to_string(i);
+    ASSERT_EQ(pool.intern(s.c_str()).get(), refs[i]);
+    ASSERT_EQ(s, refs[i]);
+  }
+}
+
+TEST(StringPool, Concurrent) {
+  StringPool pool;
+  const int kThreads = 8;
+  const int kStrings = 5000;
+  std::vector<std::vector<const char*>> results(kThreads);
+  std::vector<std::thread> threads;
+  for (auto t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&pool, &results, t]() {
+      for (auto i = 0; i < kStrings; ++i) {
+        results[t].push_back(pool.intern(std::to_string(i).c_str()).get());
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(pool.pool_size(), kStrings);
+  for (auto t = 1; t < kThreads; ++t) {
+    EXPECT_EQ(results[t], results[0]);
+  }
+}
+
+TEST(StringPool, Reclaim) {
+  StringPool pool;
+  auto counted = pool.acquire("counted");
+  auto pinned = pool.acquire("pinned");
+  pool.intern("pinned");
+  EXPECT_EQ(pool.acquire("counted", 7), counted);
+  pool.release(counted);
+  EXPECT_EQ(pool.pool_size(), 2);
+
+  // still referenced
+  pool.Sweep();
+  pool.Sweep();
+  EXPECT_EQ(pool.pool_size(), 2);
+
+  // needs to stay unreferenced for a full sweep interval
+  pool.release(counted);
+  pool.release(pinned);
+  EXPECT_EQ(pool.Sweep(), 0);
+  EXPECT_EQ(pool.Sweep(), 1);
+  EXPECT_EQ(pool.pool_size(), 1);
+  EXPECT_EQ(pool.alloc_size(), 7);
+  EXPECT_EQ(pool.intern("pinned"), pinned);
+  EXPECT_EQ(pool.acquire(pinned), pinned);
+
+  // during the grace period, acquiring a ref to a reclaimed string interns
+  // it again
+  auto again = pool.acquire(counted);
+  EXPECT_STREQ(again.get(), "counted");
+  EXPECT_EQ(pool.pool_size(), 2);
+  EXPECT_EQ(pool.acquire("counted"), again);
+  // and releasing it does nothing
+  pool.release(counted);
+  pool.release(again);
+  EXPECT_EQ(pool.pool_size(), 2);
+  pool.release(again);
+  pool.Sweep();
+  EXPECT_EQ(pool.Sweep(), 1);
+  EXPECT_EQ(pool.pool_size(), 1);
+}
+
+TEST(StringPool, ReclaimChunks) {
+  StringPool pool;
+  std::vector<StrRef> refs;
+  for (auto i = 0; i < 20000; ++i) {
+    refs.push_back(pool.acquire(std::to_string(i).c_str()));
+  }
+  std::string big(100000, 'x');
+  refs.push_back(pool.acquire(big.c_str()));
+  auto total = pool.alloc_size();
+  for (auto i = 0; i < 10000; ++i) {
+    pool.release(refs[i]);
+  }
+  pool.release(refs.back());
+  pool.Sweep();
+  pool.Sweep();
+  // give the sweeper a chance to free retired memory
+  pool.Sweep();
+  EXPECT_EQ(pool.pool_size(), 10000);
+  EXPECT_EQ(pool.alloc_size(), total - big.size() - 1 - 48890);
+  for (auto i = 10000; i < 20000; ++i) {
+    ASSERT_EQ(std::to_string(i), refs[i].get());
+    ASSERT_EQ(pool.acquire(std::to_string(i).c_str()), refs[i]);
+  }
+}
+
+TEST(StringPool, Memo) {
+  StringPool pool;
+  auto source = pool.acquire("source");
+  EXPECT_EQ(pool.memo(source, 0).get(), nullptr);
+  auto derived = pool.acquire("derived");
+  EXPECT_EQ(pool.set_memo(source, 0, derived), derived);
+  EXPECT_EQ(pool.set_memo(source, 0, pool.intern("other")), derived);
+  EXPECT_EQ(pool.memo(source, 0), derived);
+  EXPECT_EQ(pool.memo(source, 1).get(), nullptr);
+
+  // the memo keeps the derived string alive as long as the source
+  pool.release(derived);
+  pool.Sweep();
+  pool.Sweep();
+  EXPECT_EQ(pool.pool_size(), 3);
+  pool.release(source);
+  pool.Sweep();
+  EXPECT_EQ(pool.Sweep(), 1);
+  pool.Sweep();
+  EXPECT_EQ(pool.Sweep(), 1);
+  EXPECT_EQ(pool.pool_size(), 1);
+}
+
+TEST(StringPool, SelfMemo) {
+  StringPool pool;
+  auto valid = pool.acquire("valid");
+  EXPECT_EQ(pool.set_memo(valid, 0, valid), valid);
+  EXPECT_EQ(pool.memo(valid, 0), valid);
+
+  // being its own memo does not keep a string alive
+  pool.release(valid);
+  pool.Sweep();
+  EXPECT_EQ(pool.Sweep(), 1);
+  EXPECT_EQ(pool.pool_size(), 0);
+}
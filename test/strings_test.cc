@@ -75,6 +75,19 @@ TEST(Strings, EncodeValueForKey) {
       << "Multiple substitutions for normal keys";
 }
 
+TEST(Strings, SanitizedIsRemembered) {
+  auto value = to_ref("a b^c");
+  auto sanitized = ToValidCharset(value);
+  EXPECT_STREQ(sanitized.get(), "a_b_c");
+  EXPECT_EQ(ToValidCharset(value).get(), sanitized.get());
+
+  // each table gets its own memo
+  auto group = EncodeValueForKey(value, to_ref("nf.asg"));
+  EXPECT_STREQ(group.get(), "a_b^c");
+  EXPECT_EQ(EncodeValueForKey(value, to_ref("nf.cluster")).get(), group.get());
+  EXPECT_EQ(EncodeValueForKey(value, to_ref("nf.app")).get(), sanitized.get());
+}
+
 TEST(Strings, JoinPath) {
   EXPECT_EQ("./foo.log", join_path("", "foo.log"));
   EXPECT_EQ("dir/foo.log", join_path("dir", "foo.log"));
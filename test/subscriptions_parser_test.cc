@@ -0,0 +1,85 @@
+#include "../meter/subscriptions_parser.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace atlas::meter;
+
+static std::string read_file(const char* name) {
+  std::ifstream in(name);
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+
+static std::unique_ptr<Subscriptions> parse(const std::string& payload,
+                                            size_t chunk_size) {
+  SubscriptionsParser parser;
+  for (size_t i = 0; i < payload.length(); i += chunk_size) {
+    auto n = std::min(chunk_size, payload.length() - i);
+    EXPECT_TRUE(parser.Feed(payload.c_str() + i, n));
+  }
+  EXPECT_TRUE(parser.Finish());
+  return parser.Release();
+}
+
+TEST(SubscriptionsParser, Subs) {
+  auto payload = read_file("subs1.json");
+  auto expected = Subscriptions{
+      Subscription{"So3yA1c1xN_vzZASUQdORBqd9hM", 60000,
+                   "nf.cluster,skan-test,:eq,name,foometric,:eq,:and,:sum"},
+      Subscription{"tphgPWqODm0ZUhgUCwj23lpEs1o", 60000,
+                   "nf.cluster,skan,:re,name,foometric,:eq,:and,:sum"}};
+
+  for (size_t chunk_size : {1, 7, 4096}) {
+    auto subs = parse(payload, chunk_size);
+    EXPECT_EQ(*subs, expected) << "chunk size " << chunk_size;
+  }
+}
+
+TEST(SubscriptionsParser, LotsOfSubs) {
+  auto payload = read_file("many-subs.json");
+  EXPECT_EQ(parse(payload, 3)->size(), 3665);
+  EXPECT_EQ(parse(payload, payload.length())->size(), 3665);
+}
+
+TEST(SubscriptionsParser, SkipsOtherMembers) {
+  const std::string payload{
+      "/* lwc */ {\"version\": [1, 2.5e3, true, null],\n"
+      "\"expressions\": [ {\"id\": \"a\\\"\\u00e9\\ud83d\\ude00\", "
+      "\"meta\": {\"id\": \"b\", \"frequency\": 1},"
+      "\"frequency\": 10000, \"expression\": \"name,a,:eq\"},"
+      "{\"id\": \"incomplete\"}, {}]} // done"};
+  auto subs = parse(payload, 5);
+  auto expected = Subscriptions{
+      Subscription{"a\"\xc3\xa9\xf0\x9f\x98\x80", 10000, "name,a,:eq"}};
+  EXPECT_EQ(*subs, expected);
+}
+
+TEST(SubscriptionsParser, Invalid) {
+  for (const char* payload :
+       {"{\"expressions\": [}", "{\"expressions\": [{\"id\": \"a}]}", "[1 2]",
+        "{\"a\" 1}", "{\"a\": tru}", "{} {}", "{\"a\": \"\\ud800x\"}",
+        "[inf]", "[nan]", "[NaN]", "[Infinity]", "[0x1f]", "[01]", "[1.]",
+        "[.5]", "[+1]", "[1e]", "[-]"}) {
+    SubscriptionsParser parser;
+    auto fed = parser.Feed(payload, strlen(payload));
+    EXPECT_FALSE(fed && parser.Finish()) << payload;
+  }
+}
+
+TEST(SubscriptionsParser, Frequency) {
+  auto sub = [](const char* frequency) {
+    return std::string{"{\"expressions\": [{\"id\": \"a\", \"frequency\": "} +
+           frequency + ", \"expression\": \"name,a,:eq\"}]}";
+  };
+  EXPECT_EQ(parse(sub("60000"), 7)->at(0).frequency, 60000);
+  EXPECT_EQ(parse(sub("6e4"), 7)->at(0).frequency, 60000);
+  EXPECT_EQ(parse(sub("6.0E4"), 7)->at(0).frequency, 60000);
+
+  // valid json, but not a whole number of milliseconds that fits
+  for (const char* frequency :
+       {"1.5", "1e-3", "1e999", "-1e999", "99999999999999999999"}) {
+    EXPECT_TRUE(parse(sub(frequency), 7)->empty()) << frequency;
+  }
+}
@@ -2,7 +2,9 @@
 #include "../meter/manual_clock.h"
 #include "../meter/subscription_registry.h"
 #include "../util/config_manager.h"
+#include <cmath>
 #include <gtest/gtest.h>
+#include <thread>
 
 using atlas::util::Config;
 using atlas::util::ConfigManager;
@@ -30,6 +32,10 @@ class SR : public SubscriptionRegistry {
     return SubscriptionRegistry::evaluate(expression, measurements);
   }
 
+  size_t num_subs(int64_t frequency) const {
+    return SubscriptionRegistry::SubsForInterval(frequency).size();
+  }
+
  private:
   ManualClock clock_;
 };
@@ -72,3 +78,120 @@ TEST(SubscriptionRegistry, MainMetrics) {
   const auto& res = registry.GetMainMeasurements(*cfg);
   EXPECT_EQ(res.size(), 3);
 }
+
+TEST(SubscriptionRegistry, UpdateSubscriptionsDiff) {
+  SR registry;
+  Subscriptions subs{Subscription{"a", 5000, "name,a,:eq,:sum"},
+                     Subscription{"b", 5000, "name,b,:eq,:sum"}};
+  auto diff = registry.update_subscriptions(&subs);
+  EXPECT_EQ(diff.added, 2);
+  EXPECT_EQ(diff.removed, 0);
+  EXPECT_EQ(diff.unchanged, 0);
+  EXPECT_EQ(registry.num_subs(5000), 2);
+
+  Subscriptions updated{Subscription{"a", 5000, "name,a,:eq,:sum"},
+                        Subscription{"b", 5000, "name,b,:eq,:max"},
+                        Subscription{"c", 10000, "name,c,:eq,:sum"}};
+  diff = registry.update_subscriptions(&updated);
+  EXPECT_EQ(diff.added, 2);
+  EXPECT_EQ(diff.removed, 1);
+  EXPECT_EQ(diff.unchanged, 1);
+  EXPECT_EQ(registry.num_subs(5000), 2);
+  EXPECT_EQ(registry.num_subs(10000), 1);
+
+  Subscriptions none;
+  diff = registry.update_subscriptions(&none);
+  EXPECT_EQ(diff.added, 0);
+  EXPECT_EQ(diff.removed, 3);
+  EXPECT_EQ(diff.unchanged, 0);
+  EXPECT_EQ(registry.num_subs(5000), 0);
+}
+
+TEST(SubscriptionRegistry, DuplicateIds) {
+  SR registry;
+  Subscriptions subs{Subscription{"a", 5000, "name,a,:eq,:sum"},
+                     Subscription{"a", 10000, "name,a,:eq,:max"}};
+  auto diff = registry.update_subscriptions(&subs);
+  EXPECT_EQ(diff.added, 1);
+  EXPECT_EQ(registry.num_subs(5000), 1);
+  EXPECT_EQ(registry.num_subs(10000), 0);
+
+  diff = registry.update_subscriptions(&subs);
+  EXPECT_EQ(diff.added, 0);
+  EXPECT_EQ(diff.unchanged, 1);
+}
+
+TEST(SubscriptionRegistry, ReadWhileUpdating) {
+  SR registry;
+  Subscriptions one{Subscription{"a", 5000, "name,a,:eq,:sum"}};
+  Subscriptions two{Subscription{"a", 5000, "name,a,:eq,:sum"},
+                    Subscription{"b", 5000, "name,b,:eq,:sum"}};
+  std::atomic<bool> done{false};
+  std::thread reader([&registry, &done]() {
+    while (!done) {
+      auto n = registry.num_subs(5000);
+      ASSERT_TRUE(n == 0 || n == 1 || n == 2);
+    }
+  });
+  for (auto i = 0; i < 200; ++i) {
+    registry.update_subscriptions(i % 2 == 0 ? &one : &two);
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(registry.num_subs(5000), 2);
+}
+
+TEST(SubscriptionRegistry, RemoveExpiredMeters) {
+  SR registry;
+  const auto& manual_clock = static_cast<const ManualClock&>(registry.clock());
+  manual_clock.SetWall(1000);
+  registry.counter("held")->Increment();
+  registry.counter("dropped")->Increment();
+  auto held = registry.counter("held");
+  EXPECT_EQ(registry.meters().size(), 2);
+
+  EXPECT_EQ(registry.RemoveExpiredMeters(), 0);
+  manual_clock.SetWall(1000 + 16 * 60 * 1000);
+  EXPECT_EQ(registry.RemoveExpiredMeters(), 1);
+  auto meters = registry.meters();
+  ASSERT_EQ(meters.size(), 1);
+  EXPECT_STREQ(meters[0]->GetId()->Name(), "held");
+}
+
+TEST(SubscriptionRegistry, LwcMetrics) {
+  SR registry;
+  const auto& manual_clock = static_cast<const ManualClock&>(registry.clock());
+  manual_clock.SetWall(1000);
+  Subscriptions subs{Subscription{"a", 5000, "name,c1,:eq,:sum,(,name,),:by"},
+                     Subscription{"b", 5000, "name,c2,:eq,:sum,(,name,),:by"}};
+  registry.update_subscriptions(&subs);
+  registry.counter("c1")->Add(10);
+  registry.counter("c2")->Add(20);
+  manual_clock.SetWall(6000);
+  registry.counter("c1")->Add(5);
+  registry.counter("c2")->Add(10);
+  manual_clock.SetWall(11000);
+  auto results = registry.GetLwcMetricsForInterval(*DefaultConfig(), 5000);
+
+  // groups the query does not match get a NaN
+  auto found = 0;
+  for (const auto& metric : results.metrics) {
+    if (std::isnan(metric.value)) {
+      continue;
+    }
+    ++found;
+    std::string id = results.ids.at(metric.subscription).get();
+    std::string name = metric.tags.at(intern_str("name")).get();
+    EXPECT_EQ(name, id == "a" ? "c1" : "c2") << id;
+    EXPECT_DOUBLE_EQ(metric.value, id == "a" ? 1.0 : 2.0) << id;
+  }
+  EXPECT_EQ(found, 2);
+  // ids are interned when subscriptions are compiled, and the results hold
+  // a reference to them after the subscriptions are gone
+  ASSERT_EQ(results.ids.size(), 2);
+  std::vector<std::string> ids{results.ids[0].get(), results.ids[1].get()};
+  Subscriptions none;
+  registry.update_subscriptions(&none);
+  EXPECT_EQ(ids[0], results.ids[0].get());
+  EXPECT_EQ(ids[1], results.ids[1].get());
+}
@@ -0,0 +1,79 @@
+#include "../meter/id.h"
+#include <gtest/gtest.h>
+
+using atlas::meter::Tags;
+using atlas::util::intern_str;
+
+TEST(Tags, OrderIndependent) {
+  Tags a{{"k1", "v1"}, {"k2", "v2"}, {"k3", "v3"}};
+  Tags b;
+  b.add("k3", "v3");
+  b.add("k1", "v1");
+  b.add("k2", "v2");
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.hash(), b.hash());
+
+  b.add("k2", "other");
+  EXPECT_FALSE(a == b);
+  b.add("k2", "v2");
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.hash(), b.hash());
+}
+
+TEST(Tags, Find) {
+  Tags tags{{"k1", "v1"}, {"k2", "v2"}};
+  EXPECT_TRUE(tags.has(intern_str("k1")));
+  EXPECT_FALSE(tags.has(intern_str("v1")));
+  EXPECT_EQ(tags.find(intern_str("k3")), tags.end());
+  EXPECT_EQ(tags.at(intern_str("k2")), intern_str("v2"));
+  EXPECT_EQ(tags.at(intern_str("k3")), intern_str(""));
+}
+
+TEST(Tags, Grows) {
+  Tags tags;
+  for (auto i = 0; i < 50; ++i) {
+    auto s = std::to_string(i);
+    tags.add(s.c_str(), s.c_str());
+  }
+  Tags copy{tags};
+  Tags moved{std::move(copy)};
+  EXPECT_EQ(moved.size(), 50);
+  EXPECT_EQ(moved, tags);
+  for (const auto& tag : moved) {
+    EXPECT_EQ(tag.first, tag.second);
+  }
+
+  Tags common{{"0", "x"}, {"common", "y"}};
+  moved.add_all(common);
+  EXPECT_EQ(moved.size(), 51);
+  EXPECT_EQ(moved.at(intern_str("0")), intern_str("0"));
+}
+
+TEST(Tags, Merge) {
+  Tags common{{"nf.app", "app"}, {"nf.region", "us-east-1"}, {"k", "common"}};
+  Tags own{{"k", "own"}, {"statistic", "count"}};
+  auto merged = Tags::Merge(common, own);
+
+  Tags expected{common};
+  expected.add_all(own);
+  EXPECT_EQ(merged, expected);
+  EXPECT_EQ(merged.hash(), expected.hash());
+  EXPECT_EQ(merged.at(intern_str("k")), intern_str("common"));
+  EXPECT_EQ(Tags::Merge(own, Tags{}), own);
+  EXPECT_EQ(Tags::Merge(Tags{}, own), own);
+}
+
+TEST(CountedTags, Add) {
+  using atlas::meter::CountedTags;
+  CountedTags counted{Tags{{"k1", "v1"}}};
+  auto copy = counted;
+  copy.add("k2", "v2");
+  copy.add("k1", "other");
+  counted.add_all(copy.get());
+
+  Tags expected{{"k1", "v1"}, {"k2", "v2"}};
+  EXPECT_EQ(counted.get(), expected);
+  EXPECT_EQ(copy.get(), (Tags{{"k1", "other"}, {"k2", "v2"}}));
+  counted = std::move(copy);
+  EXPECT_EQ(counted.get().size(), 2);
+}
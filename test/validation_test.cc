@@ -73,4 +73,22 @@ TEST(Validation, TooManyUserTags) {
 
   tags.add("extra", "v");
   EXPECT_FALSE(IsValid(tags));
-}
\ No newline at end of file
+}
+
+TEST(Validation, Cache) {
+  atlas::meter::validation::ValidationCache cache;
+  Tags valid{{"name", "foo"}, {"k", "v"}};
+  Tags invalid{{"name", "foo"}, {"nf.foo", "v"}};
+  EXPECT_TRUE(cache.IsValid(valid));
+  EXPECT_FALSE(cache.IsValid(invalid));
+  EXPECT_TRUE(cache.IsValid(Tags{{"k", "v"}, {"name", "foo"}}));
+  EXPECT_EQ(cache.size(), 2);
+
+  // verdicts are kept while they are used
+  cache.Rotate();
+  EXPECT_TRUE(cache.IsValid(valid));
+  cache.Rotate();
+  EXPECT_EQ(cache.size(), 1);
+  cache.Rotate();
+  EXPECT_EQ(cache.size(), 0);
+}
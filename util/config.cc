@@ -18,6 +18,8 @@ Config::Config(const std::string& disabled_file,
                int read_timeout, int batch_size, bool force_start,
                bool enable_main, bool enable_subscriptions, bool dump_metrics,
                bool dump_subscriptions, int log_verbosity,
+               PayloadFormat publish_format, GzipParams gzip_options,
+               std::string spill_file, int spill_megabytes,
                meter::Tags common_tags) noexcept
     : disabled_file_watcher_(disabled_file),
       evaluate_endpoint_(ExpandEnvVars(evaluate_endpoint)),
@@ -37,6 +39,10 @@ Config::Config(const std::string& disabled_file,
       dump_metrics_(dump_metrics),
       dump_subscriptions_(dump_subscriptions),
       log_verbosity_(log_verbosity),
+      publish_format_(publish_format),
+      gzip_options_(gzip_options),
+      spill_file_(std::move(spill_file)),
+      spill_megabytes_(spill_megabytes),
       common_tags_(std::move(common_tags)) {}
 
 std::string Config::LoggingDirectory() const noexcept {
@@ -72,7 +78,14 @@ std::string ConfigToString(const Config& config) noexcept {
      << ", batch=" << config.BatchSize()
      << ", Timeouts(C=" << config.ConnectTimeout()
      << ",R=" << config.ReadTimeout()
-     << "), logVerbosity=" << config.LogVerbosity() << ")\n"
+     << "), logVerbosity=" << config.LogVerbosity()
+     << ", publishFormat="
+     << (config.PublishFormat() == PayloadFormat::Binary ? "binary" : "json")
+     << ", gzip(level=" << config.GzipOptions().level
+     << ",strategy=" << config.GzipOptions().strategy << ")"
+     << ", spill=" << config.SpillFile() << "(" << config.SpillMegabytes()
+     << "MB)"
+     << ")\n"
      << ", common-tags=";
   dump_tags(os, config.CommonTags());
   os << "}";
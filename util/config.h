@@ -6,6 +6,7 @@
 #include <vector>
 #include "../meter/id.h"
 #include "file_watcher.h"
+#include "gzip.h"
 
 namespace atlas {
 namespace util {
@@ -13,6 +14,9 @@ namespace util {
 // step-size for main in milliseconds
 static constexpr int kMainFrequencyMillis{60000};
 
+// encoding of the payloads sent to the main publish cluster
+enum class PayloadFormat { Json, Binary };
+
 class Config {
  public:
   Config(const std::string& disabled_file, const std::string& evaluate_endpoint,
@@ -23,6 +27,8 @@ class Config {
          int connect_timeout, int read_timeout, int batch_size,
          bool force_start, bool enable_main, bool enable_subscriptions,
          bool dump_metrics, bool dump_subscriptions, int log_verbosity,
+         PayloadFormat publish_format, GzipParams gzip_options,
+         std::string spill_file, int spill_megabytes,
          meter::Tags common_tags) noexcept;
 
   std::string EvalEndpoint() const noexcept { return evaluate_endpoint_; }
@@ -47,7 +53,12 @@ class Config {
     return publish_config_;
   }
   int LogVerbosity() const noexcept { return log_verbosity_; }
-  meter::Tags CommonTags() const noexcept { return common_tags_; }
+  PayloadFormat PublishFormat() const noexcept { return publish_format_; }
+  const GzipParams& GzipOptions() const noexcept { return gzip_options_; }
+  /// where to keep batches that could not be published, empty to drop them
+  const std::string& SpillFile() const noexcept { return spill_file_; }
+  int SpillMegabytes() const noexcept { return spill_megabytes_; }
+  const meter::Tags& CommonTags() const noexcept { return common_tags_.get(); }
   void AddCommonTags(const meter::Tags& extra_tags) noexcept {
     common_tags_.add_all(extra_tags);
   }
@@ -74,7 +85,11 @@ class Config {
   bool dump_metrics_;
   bool dump_subscriptions_;
   int log_verbosity_;
-  meter::Tags common_tags_;
+  PayloadFormat publish_format_;
+  GzipParams gzip_options_;
+  std::string spill_file_;
+  int spill_megabytes_;
+  meter::CountedTags common_tags_;
 };
 
 std::string ConfigToString(const Config& config) noexcept;
@@ -12,6 +12,7 @@ static constexpr int kConnectTimeout = 6;
 static constexpr int kReadTimeout = 20;
 static constexpr int kBatchSize = 10000;
 static constexpr bool kValidateMetrics = true;
+static constexpr int kSpillMegabytes = 64;
 
 static const char* kEvaluateUrl =
     "http://atlas-lwcapi-iep.$EC2_REGION.iep$NETFLIX_ENVIRONMENT.netflix.net/"
@@ -66,6 +67,51 @@ static meter::Tags get_default_common_tags() {
   return common_tags_;
 }
 
+static PayloadFormat format_from(const rapidjson::Value& value,
+                                 PayloadFormat default_format) noexcept {
+  if (!value.IsString()) {
+    return default_format;
+  }
+  std::string format = value.GetString();
+  if (format == "json") {
+    return PayloadFormat::Json;
+  }
+  if (format == "binary") {
+    return PayloadFormat::Binary;
+  }
+  Logger()->error("Unknown publishFormat {}, ignoring it", format);
+  return default_format;
+}
+
+static int strategy_from(const rapidjson::Value& value,
+                         int default_strategy) noexcept {
+  static const std::map<std::string, int> strategies{
+      {"default", Z_DEFAULT_STRATEGY},
+      {"filtered", Z_FILTERED},
+      {"huffman", Z_HUFFMAN_ONLY},
+      {"rle", Z_RLE}};
+  if (!value.IsString()) {
+    return default_strategy;
+  }
+  auto it = strategies.find(value.GetString());
+  if (it == strategies.end()) {
+    Logger()->error("Unknown compressionStrategy {}, ignoring it",
+                    value.GetString());
+    return default_strategy;
+  }
+  return it->second;
+}
+
+static int level_from(const rapidjson::Value& value,
+                      int default_level) noexcept {
+  if (!value.IsInt() || value.GetInt() < Z_DEFAULT_COMPRESSION ||
+      value.GetInt() > Z_BEST_COMPRESSION) {
+    Logger()->error("compressionLevel must be between -1 and 9, ignoring it");
+    return default_level;
+  }
+  return value.GetInt();
+}
+
 static std::unique_ptr<Config> DocToConfig(
     const rapidjson::Document& document,
     std::unique_ptr<Config> defaults) noexcept {
@@ -145,12 +191,36 @@ static std::unique_ptr<Config> DocToConfig(
                            ? document["logVerbosity"].GetInt()
                            : defaults->LogVerbosity();
 
+  auto publish_format =
+      document.HasMember("publishFormat")
+          ? format_from(document["publishFormat"], defaults->PublishFormat())
+          : defaults->PublishFormat();
+
+  auto gzip_options = defaults->GzipOptions();
+  if (document.HasMember("compressionLevel")) {
+    gzip_options.level =
+        level_from(document["compressionLevel"], gzip_options.level);
+  }
+  if (document.HasMember("compressionStrategy")) {
+    gzip_options.strategy =
+        strategy_from(document["compressionStrategy"], gzip_options.strategy);
+  }
+
+  std::string spill_file = document.HasMember("spillFile")
+                               ? document["spillFile"].GetString()
+                               : defaults->SpillFile();
+
+  auto spill_megabytes = document.HasMember("spillMegabytes")
+                             ? document["spillMegabytes"].GetInt()
+                             : defaults->SpillMegabytes();
+
   return std::make_unique<Config>(
       defaults->DisabledFile(), eval_url, sub_endpoint, publish_endpoint,
       validate_metrics, check_cluster_endpoint, notify_alert_server,
       publish_config, sub_refresh, connect_timeout, read_timeout, batch_size,
       force_start, main_enabled, subs_enabled, dump_metrics, dump_subscriptions,
-      log_verbosity, get_default_common_tags());
+      log_verbosity, publish_format, gzip_options, spill_file, spill_megabytes,
+      get_default_common_tags());
 }
 
 static std::unique_ptr<Config> ParseConfigFile(
@@ -192,7 +262,9 @@ std::unique_ptr<Config> DefaultConfig() noexcept {
       // enable main but not subscriptions yet (need clusters in main account)
       true, false,
       // do not dump main or subs
-      false, false, kDefaultVerbosity, get_default_common_tags());
+      false, false, kDefaultVerbosity, PayloadFormat::Json, GzipParams{},
+      // do not spill failed batches to disk
+      std::string(), kSpillMegabytes, get_default_common_tags());
 }
 
 static constexpr const char* const kGlobalFile =
@@ -238,7 +310,7 @@ void ConfigManager::refresh_configs() noexcept {
   auto new_config = GetCurrentConfig();
   SetLoggingLevel(new_config->LogVerbosity());
   std::lock_guard<std::mutex> lock{config_mutex};
-  new_config->AddCommonTags(extra_tags_);
+  new_config->AddCommonTags(extra_tags_.get());
   current_config_ = std::move(new_config);
 }
 
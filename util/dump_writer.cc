@@ -0,0 +1,118 @@
+#include "dump_writer.h"
+#include "logger.h"
+#include <chrono>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace atlas {
+namespace util {
+
+DumpWriter::DumpWriter(std::string dir, size_t max_queued_bytes,
+                       size_t max_files, size_t max_file_bytes) noexcept
+    : dir_(std::move(dir)),
+      max_queued_bytes_(max_queued_bytes),
+      max_files_(max_files),
+      max_file_bytes_(max_file_bytes) {}
+
+DumpWriter::~DumpWriter() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    done_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool DumpWriter::Dump(const std::string& prefix, const char* extension,
+                      std::shared_ptr<const std::string> payload) {
+  auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto size = payload->size();
+    if (queued_bytes_ + size > max_queued_bytes_) {
+      return false;
+    }
+    auto file_name = dir_ + "/" + prefix + std::to_string(millis) + "_" +
+                     std::to_string(seq_++) + extension + ".gz";
+    queue_.push_back(Item{std::move(file_name), prefix, std::move(payload)});
+    queued_bytes_ += size;
+    // only start a thread once something gets dumped
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&DumpWriter::Run, this);
+    }
+  }
+  cv_.notify_all();
+  return true;
+}
+
+void DumpWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return queue_.empty() && writing_ == 0; });
+}
+
+void DumpWriter::Run() noexcept {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] { return done_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    auto item = std::move(queue_.front());
+    queue_.pop_front();
+    ++writing_;
+    lock.unlock();
+    Write(item);
+    Rotate(item.prefix);
+    lock.lock();
+    queued_bytes_ -= item.payload->size();
+    --writing_;
+    cv_.notify_all();
+  }
+}
+
+void DumpWriter::Write(const Item& item) noexcept {
+  auto logger = Logger();
+  auto fd = gzopen(item.file_name.c_str(), "wb");
+  if (fd == nullptr) {
+    logger->error("Unable to open {}", item.file_name);
+    return;
+  }
+  gzbuffer(fd, 65536);
+  const auto& payload = *item.payload;
+  auto written =
+      gzwrite(fd, payload.data(), static_cast<unsigned>(payload.size()));
+  if (written <= 0 && !payload.empty()) {
+    logger->error("Unable to write compressed file {}", item.file_name);
+  }
+  gzclose(fd);
+
+  struct stat st;
+  auto size = stat(item.file_name.c_str(), &st) == 0
+                  ? static_cast<size_t>(st.st_size)
+                  : 0;
+  files_[item.prefix].push_back(File{item.file_name, size});
+  file_bytes_[item.prefix] += size;
+}
+
+void DumpWriter::Rotate(const std::string& prefix) noexcept {
+  auto& files = files_[prefix];
+  auto& bytes = file_bytes_[prefix];
+  // always keep the latest file
+  while (files.size() > 1 &&
+         (files.size() > max_files_ || bytes > max_file_bytes_)) {
+    const auto& oldest = files.front();
+    if (unlink(oldest.name.c_str()) != 0) {
+      Logger()->debug("Unable to remove old dump {}", oldest.name);
+    }
+    bytes -= oldest.size;
+    files.pop_front();
+  }
+}
+
+}  // namespace util
+}  // namespace atlas
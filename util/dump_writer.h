@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace atlas {
+namespace util {
+
+/// Writes payloads to gzip files on a background thread, so dumping them for
+/// debugging does not slow down the threads sending them. Payloads wait in a
+/// queue bounded by size, and new ones are dropped while it is full. For each
+/// file prefix only the most recent files are kept, up to a number of files
+/// and a total size
+class DumpWriter {
+ public:
+  DumpWriter(std::string dir, size_t max_queued_bytes, size_t max_files,
+             size_t max_file_bytes) noexcept;
+
+  /// writes the payloads that are still queued
+  ~DumpWriter();
+
+  DumpWriter(const DumpWriter&) = delete;
+  DumpWriter& operator=(const DumpWriter&) = delete;
+
+  /// Queue payload to be written to a file named prefix, a timestamp and
+  /// extension, followed by .gz. The payload is shared, not copied, so it
+  /// must not change afterwards. Returns false if the queue is full and the
+  /// payload was dropped
+  bool Dump(const std::string& prefix, const char* extension,
+            std::shared_ptr<const std::string> payload);
+
+  /// wait until every queued payload has been written
+  void Flush();
+
+ private:
+  struct Item {
+    std::string file_name;
+    std::string prefix;
+    std::shared_ptr<const std::string> payload;
+  };
+  struct File {
+    std::string name;
+    size_t size;
+  };
+
+  const std::string dir_;
+  const size_t max_queued_bytes_;
+  const size_t max_files_;
+  const size_t max_file_bytes_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Item> queue_;
+  size_t queued_bytes_ = 0;
+  size_t writing_ = 0;
+  uint64_t seq_ = 0;
+  bool done_ = false;
+  std::thread thread_;
+
+  // only used by the writer thread: the files written for each prefix, oldest
+  // first, and their total size
+  std::map<std::string, std::deque<File>> files_;
+  std::map<std::string, size_t> file_bytes_;
+
+  void Run() noexcept;
+  void Write(const Item& item) noexcept;
+  void Rotate(const std::string& prefix) noexcept;
+};
+
+}  // namespace util
+}  // namespace atlas
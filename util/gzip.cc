@@ -1,4 +1,5 @@
 #include "gzip.h"
+#include <new>
 
 #ifndef z_const
 #define z_const
@@ -64,5 +65,77 @@ int gzip_uncompress(Bytef* dest, uLongf* destLen, const Bytef* source,
 
   return inflateEnd(&stream);
 }
+
+GzipCompressor::GzipCompressor() noexcept {}
+
+GzipCompressor::~GzipCompressor() {
+  if (initialized_) {
+    deflateEnd(&stream_);
+  }
+}
+
+int GzipCompressor::Init(const GzipParams& options) noexcept {
+  stream_.zalloc = static_cast<alloc_func>(nullptr);
+  stream_.zfree = static_cast<free_func>(nullptr);
+  stream_.opaque = static_cast<voidpf>(nullptr);
+  auto err = deflateInit2(&stream_, options.level, Z_DEFLATED, 31, 9,
+                          options.strategy);
+  if (err == Z_OK) {
+    initialized_ = true;
+    options_ = options;
+  }
+  return err;
+}
+
+int GzipCompressor::Compress(const Bytef* source, size_t size,
+                             const GzipParams& options) noexcept {
+  size_ = 0;
+  if (!initialized_) {
+    auto err = Init(options);
+    if (err != Z_OK) {
+      return err;
+    }
+  } else {
+    auto err = deflateReset(&stream_);
+    if (err == Z_OK && (options.level != options_.level ||
+                        options.strategy != options_.strategy)) {
+      // nothing has been compressed since the reset, so this only changes
+      // the settings
+      err = deflateParams(&stream_, options.level, options.strategy);
+      if (err == Z_OK) {
+        options_ = options;
+      }
+    }
+    if (err != Z_OK) {
+      return err;
+    }
+  }
+
+  auto bound = deflateBound(&stream_, static_cast<uLong>(size));
+  if (bound > capacity_) {
+    buf_.reset(new (std::nothrow) Bytef[bound]);
+    capacity_ = buf_ ? bound : 0;
+    if (!buf_) {
+      return Z_MEM_ERROR;
+    }
+  }
+
+  stream_.next_in = const_cast<z_const Bytef*>(source);
+  stream_.avail_in = static_cast<uInt>(size);
+  stream_.next_out = buf_.get();
+  stream_.avail_out = static_cast<uInt>(capacity_);
+  auto err = deflate(&stream_, Z_FINISH);
+  if (err != Z_STREAM_END) {
+    return err == Z_OK ? Z_BUF_ERROR : err;
+  }
+  size_ = stream_.total_out;
+  return Z_OK;
+}
+
+GzipCompressor& ThreadGzipCompressor() noexcept {
+  static thread_local GzipCompressor compressor;
+  return compressor;
+}
+
 }  // namespace util
 }  // namespace atlas
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <zlib.h>
 
 namespace atlas {
@@ -9,5 +10,45 @@ int gzip_compress(Bytef* dest, uLongf* destLen, const Bytef* source,
                   uLong sourceLen);
 int gzip_uncompress(Bytef* dest, uLongf* destLen, const Bytef* source,
                     uLong sourceLen);
-}
-}
+
+/// How hard to compress payloads. Lower levels, or the rle and huffman only
+/// strategies, trade bigger payloads for less CPU
+struct GzipParams {
+  int level = Z_DEFAULT_COMPRESSION;
+  int strategy = Z_DEFAULT_STRATEGY;
+};
+
+/// A gzip compressor that keeps its deflate state and output buffer between
+/// payloads, so once the buffer is big enough compressing does not allocate.
+/// Not thread safe: use one per thread
+class GzipCompressor {
+ public:
+  GzipCompressor() noexcept;
+  ~GzipCompressor();
+  GzipCompressor(const GzipCompressor&) = delete;
+  GzipCompressor& operator=(const GzipCompressor&) = delete;
+
+  /// compress source, which is then available through data and size until
+  /// the next call. Returns a zlib error code
+  int Compress(const Bytef* source, size_t size,
+               const GzipParams& options) noexcept;
+
+  const Bytef* data() const noexcept { return buf_.get(); }
+  size_t size() const noexcept { return size_; }
+
+ private:
+  z_stream stream_;
+  bool initialized_ = false;
+  GzipParams options_;
+  std::unique_ptr<Bytef[]> buf_;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+
+  int Init(const GzipParams& options) noexcept;
+};
+
+/// the compressor for the calling thread
+GzipCompressor& ThreadGzipCompressor() noexcept;
+
+}  // namespace util
+}  // namespace atlas
@@ -34,6 +34,14 @@ size_t write_memory_callback(void* contents, size_t size, size_t nmemb,
   memory[mem->size] = 0;
   return real_size;
 }
+
+size_t write_handler_callback(void* contents, size_t size, size_t nmemb,
+                              void* userp) {
+  auto real_size = size * nmemb;
+  auto handler = static_cast<const http::BodyHandler*>(userp);
+  (*handler)(static_cast<const char*>(contents), real_size);
+  return real_size;
+}
 }  // namespace
 
 constexpr const char* const kUserAgent = "atlas-native/1.0";
@@ -58,31 +66,46 @@ static size_t header_callback(char* buffer, size_t size, size_t n_items,
   return size * n_items;
 }
 
+constexpr int http::kTransportError;
+constexpr int http::kLocalError;
+
 int http::conditional_get(const std::string& url, std::string& etag,
                           int connect_timeout, int read_timeout,
                           std::string& res) const {
+  std::string body;
+  auto http_code = conditional_stream(
+      url, etag, connect_timeout, read_timeout,
+      [&body](const char* data, size_t size) { body.append(data, size); });
+  if (http_code != 304) {  // if we got something back
+    res.swap(body);
+  }
+  return http_code;
+}
+
+int http::conditional_stream(const std::string& url, std::string& etag,
+                             int connect_timeout, int read_timeout,
+                             const BodyHandler& handler) const {
   auto logger = Logger();
   logger->debug("Conditionally getting url: {} etag: {}", url, etag);
   auto curl = curl_easy_init();
   // url to get
   curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  // send all data to this function
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
+  // send all data to the handler
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_handler_callback);
+  curl_slist* headers = nullptr;
   if (!etag.empty()) {
     std::string ifNone = std::string("If-None-Match: ") + etag;
-    auto headers = curl_slist_append(nullptr, ifNone.c_str());
+    headers = curl_slist_append(nullptr, ifNone.c_str());
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
   }
 
-  MemStruct chunk{malloc(1), 0};  // we'll realloc as needed
   SetOptions(curl, connect_timeout, read_timeout);
-  // pass chunk to the callback function
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &handler);
   curl_easy_setopt(curl, CURLOPT_HEADERDATA, &etag);
   curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
   auto curl_res = curl_easy_perform(curl);
   // due to curl_easy_getinfo taking a long*
-  long http_code = 400;
+  long http_code = http::kTransportError;
   bool error = false;
 
   if (curl_res != CURLE_OK) {
@@ -90,14 +113,11 @@ int http::conditional_get(const std::string& url, std::string& etag,
     error = true;
   } else {
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    if (http_code != 304) {  // if we got something back
-      res.assign(static_cast<char*>(chunk.memory), chunk.size);
-    }
   }
-  free(chunk.memory);
   curl_easy_cleanup(curl);
+  curl_slist_free_all(headers);
   if (!error) {
-    logger->debug("Was able to fetch {} - status code: ", url, http_code);
+    logger->debug("Was able to fetch {} - status code: {}", url, http_code);
     if (http_code == 0) {
       http_code = 200;
     }  // for file:///
@@ -121,7 +141,7 @@ int http::get(const std::string& url, int connect_timeout, int read_timeout,
   curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
   SetOptions(curl, connect_timeout, read_timeout);
   auto curl_res = curl_easy_perform(curl);
-  long http_code = 400;
+  long http_code = http::kTransportError;
   bool error = false;
 
   if (curl_res != CURLE_OK) {
@@ -158,7 +178,7 @@ static int do_post(const char* url, int connect_timeout, int read_timeout,
 
   auto curl_res = curl_easy_perform(curl);
   bool error = false;
-  long http_code = 400;
+  long http_code = http::kTransportError;
 
   if (curl_res != CURLE_OK) {
     logger->error("Failed to POST {}: {}", url, curl_easy_strerror(curl_res));
@@ -186,23 +206,21 @@ int http::post(const std::string& url, int connect_timeout, int read_timeout,
   }
 
   headers = curl_slist_append(headers, "Content-Encoding: gzip");
-  auto compressed_size = compressBound(size) + 16;
-  auto compressed_payload =
-      std::unique_ptr<Bytef[]>(new Bytef[compressed_size]);
-  auto compress_res =
-      gzip_compress(compressed_payload.get(), &compressed_size,
-                    reinterpret_cast<const Bytef*>(payload), size);
+  // reuses the deflate state and output buffer of previous posts
+  auto& compressor = ThreadGzipCompressor();
+  auto compress_res = compressor.Compress(
+      reinterpret_cast<const Bytef*>(payload), size, gzip_options_);
   if (compress_res != Z_OK) {
     Logger()->error(
         "Failed to compress payload: {}, while posting to {} - uncompressed "
         "size: {}",
         compress_res, url, size);
     curl_slist_free_all(headers);
-    return 400;
+    return kLocalError;
   }
 
   return do_post(url.c_str(), connect_timeout, read_timeout, headers,
-                 compressed_payload.get(), compressed_size);
+                 compressor.data(), compressor.size());
 }
 
 static constexpr const char* const json_type = "Content-Type: application/json";
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "gzip.h"
 #include <rapidjson/document.h>
 #include <spdlog/spdlog.h>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -11,10 +13,31 @@ namespace util {
 
 class http {
  public:
+  /// returned instead of a status code when the request could not be made
+  static constexpr int kTransportError = -1;
+  /// returned when the request failed before it was sent, for example when
+  /// the payload could not be compressed. Retrying it would fail again
+  static constexpr int kLocalError = -2;
+
+  http() = default;
+
+  /// compress the payloads we post with the given options
+  explicit http(const GzipParams& gzip_options) noexcept
+      : gzip_options_(gzip_options) {}
+
+  /// Receives the body of a response in chunks, as they arrive
+  using BodyHandler = std::function<void(const char* data, size_t size)>;
+
   int conditional_get(const std::string& url, std::string& etag,
                       int connect_timeout, int read_timeout,
                       std::string& res) const;
 
+  /// Like conditional_get, but the body is passed to the handler as it
+  /// arrives instead of being buffered
+  int conditional_stream(const std::string& url, std::string& etag,
+                         int connect_timeout, int read_timeout,
+                         const BodyHandler& handler) const;
+
   int get(const std::string& url, int connect_timeout, int read_timeout,
           std::string& res) const;
 
@@ -23,6 +46,9 @@ class http {
 
   int post(const std::string& url, int connect_timeout, int read_timeout,
            const rapidjson::Document& payload) const;
+
+ private:
+  GzipParams gzip_options_;
 };
 }
 }
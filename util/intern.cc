@@ -1,5 +1,7 @@
 #include "intern.h"
 #include "string_pool.h"
+#include <cstdio>
+#include <cstring>
 
 namespace atlas {
 namespace util {
@@ -19,5 +21,25 @@ const StrRef& intern_str(const std::string& string) {
   return intern_str(string.c_str());
 }
 
+const StrRef& intern_str(const char* string, size_t size) {
+  return the_str_pool().intern(string, size);
+}
+
+StrRef acquire_str(const char* string) {
+  return the_str_pool().acquire(string);
+}
+
+StrRef acquire_str(const std::string& string) {
+  return the_str_pool().acquire(string.c_str(), string.size());
+}
+
+StrRef acquire_str(const char* string, size_t size) {
+  return the_str_pool().acquire(string, size);
+}
+
+StrRef acquire_ref(StrRef ref) { return the_str_pool().acquire(ref); }
+
+void release_ref(StrRef ref) { the_str_pool().release(ref); }
+
 }  // namespace util
 }  // namespace atlas
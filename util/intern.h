@@ -8,6 +8,13 @@ namespace util {
 
 class StringPool;
 
+/// A pointer to an interned string. Copying a StrRef does not take a
+/// reference: a copy is only valid while something else keeps the string
+/// alive, either because it was pinned with intern_str or because a counted
+/// reference taken with acquire_str or acquire_ref is still held. Only owners
+/// that keep a ref for longer than a sweep interval of the string pool, like
+/// ids, the configuration or compiled subscriptions, take references. Other
+/// copies rely on the grace period described in string_pool.h
 class StrRef {
  public:
   StrRef() = default;
@@ -22,6 +29,20 @@ class StrRef {
 
 const StrRef& intern_str(const char* string);
 const StrRef& intern_str(const std::string& string);
+/// intern a string that is not null terminated, like a slice of a larger one
+const StrRef& intern_str(const char* string, size_t size);
+
+/// Like intern_str, but the string is reference counted: it can be reclaimed
+/// once every reference taken with acquire_str or acquire_ref has been given
+/// back with release_ref
+StrRef acquire_str(const char* string);
+StrRef acquire_str(const std::string& string);
+StrRef acquire_str(const char* string, size_t size);
+/// take a reference to a string and return the ref it was taken on. This is
+/// ref itself, unless the string was reclaimed during the grace period, in
+/// which case it is interned again
+StrRef acquire_ref(StrRef ref);
+void release_ref(StrRef ref);
 }
 }
 
@@ -0,0 +1,118 @@
+#include "json_writer.h"
+#include <cmath>
+#include <cstring>
+#include <rapidjson/internal/dtoa.h>
+#include <rapidjson/internal/itoa.h>
+
+namespace atlas {
+namespace util {
+
+JsonWriter::JsonWriter(size_t capacity) { buf_.reserve(capacity); }
+
+void JsonWriter::Prefix() {
+  if (levels_.empty()) {
+    return;
+  }
+  auto& level = levels_.back();
+  if (level.after_key) {
+    buf_ += ':';
+    level.after_key = false;
+    return;
+  }
+  if (!level.first) {
+    buf_ += ',';
+  }
+  level.first = false;
+  // in an object keys and values alternate
+  level.after_key = level.in_object;
+}
+
+void JsonWriter::EndLevel(char end) {
+  levels_.pop_back();
+  buf_ += end;
+}
+
+void JsonWriter::StartObject() {
+  Prefix();
+  levels_.push_back(Level{true, true, false});
+  buf_ += '{';
+}
+
+void JsonWriter::EndObject() { EndLevel('}'); }
+
+void JsonWriter::StartArray() {
+  Prefix();
+  levels_.push_back(Level{false, true, false});
+  buf_ += '[';
+}
+
+void JsonWriter::EndArray() { EndLevel(']'); }
+
+// the character that follows the backslash for chars that need escaping, or 0
+static const char kEscape[128] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u',
+    'f', 'r', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',   0,   0, '"',   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, '\\'};
+
+void JsonWriter::String(const char* s) { String(s, strlen(s)); }
+
+void JsonWriter::String(const char* s, size_t size) {
+  static const char kHexDigits[] = "0123456789ABCDEF";
+  Prefix();
+  buf_ += '"';
+  auto start = s;
+  auto end = s + size;
+  for (auto p = s; p < end; ++p) {
+    auto c = static_cast<unsigned char>(*p);
+    if (c >= sizeof kEscape || kEscape[c] == 0) {
+      continue;
+    }
+    buf_.append(start, static_cast<size_t>(p - start));
+    start = p + 1;
+    buf_ += '\\';
+    buf_ += kEscape[c];
+    if (kEscape[c] == 'u') {
+      buf_ += "00";
+      buf_ += kHexDigits[c >> 4];
+      buf_ += kHexDigits[c & 0xF];
+    }
+  }
+  buf_.append(start, static_cast<size_t>(end - start));
+  buf_ += '"';
+}
+
+void JsonWriter::SafeString(const char* s) {
+  Prefix();
+  buf_ += '"';
+  buf_ += s;
+  buf_ += '"';
+}
+
+void JsonWriter::Int64(int64_t n) {
+  Prefix();
+  char buffer[32];
+  auto end = rapidjson::internal::i64toa(n, buffer);
+  buf_.append(buffer, static_cast<size_t>(end - buffer));
+}
+
+void JsonWriter::Double(double d) {
+  Prefix();
+  if (std::isnan(d)) {
+    buf_ += "NaN";
+  } else if (std::isinf(d)) {
+    buf_ += d < 0 ? "-Infinity" : "Infinity";
+  } else {
+    // grisu2, the shortest representation that reads back as the same double
+    char buffer[32];
+    auto end = rapidjson::internal::dtoa(d, buffer);
+    buf_.append(buffer, static_cast<size_t>(end - buffer));
+  }
+}
+
+}  // namespace util
+}  // namespace atlas
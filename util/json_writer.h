@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace atlas {
+namespace util {
+
+/// Writes JSON straight into a growable buffer, adding separators as needed.
+/// Produces the same output as the rapidjson writer we use, including NaN and
+/// Infinity for non-finite doubles, without building a document first
+class JsonWriter {
+ public:
+  explicit JsonWriter(size_t capacity = 4096);
+
+  void StartObject();
+  void EndObject();
+  void StartArray();
+  void EndArray();
+
+  /// write a key or a string value, escaping it as needed
+  void String(const char* s);
+  void String(const char* s, size_t size);
+
+  /// write a key or a string value that is known not to need escaping, like
+  /// a tag that was already converted to the atlas charset
+  void SafeString(const char* s);
+
+  void Int64(int64_t n);
+  void Double(double d);
+
+  const std::string& Result() const noexcept { return buf_; }
+
+ private:
+  struct Level {
+    bool in_object;
+    bool first;
+    bool after_key;
+  };
+  std::string buf_;
+  std::vector<Level> levels_;
+
+  void Prefix();
+  void EndLevel(char end);
+};
+
+}  // namespace util
+}  // namespace atlas
@@ -0,0 +1,152 @@
+#include "scheduler.h"
+#include "logger.h"
+
+namespace atlas {
+namespace util {
+
+Scheduler::Scheduler(size_t num_workers, LagObserver lag_observer) noexcept
+    : num_workers_(num_workers), lag_observer_(std::move(lag_observer)) {}
+
+Scheduler::~Scheduler() { Stop(); }
+
+void Scheduler::Start() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  timer_thread_ = std::thread(&Scheduler::RunTimers, this);
+  for (size_t i = 0; i < num_workers_; ++i) {
+    workers_.emplace_back(&Scheduler::RunWorker, this);
+  }
+}
+
+Scheduler::Clock::time_point Scheduler::NextAligned(
+    Clock::duration period, Clock::duration offset, Clock::time_point now,
+    std::chrono::system_clock::time_point wall_now) noexcept {
+  auto wall = std::chrono::duration_cast<Clock::duration>(
+      wall_now.time_since_epoch());
+  auto step = (wall - offset) / period + 1;
+  return now + (step * period + offset - wall);
+}
+
+// when the next run of a task aligned to the wall clock is due
+static Scheduler::Clock::time_point NextAlignedFromNow(
+    Scheduler::Clock::duration period, Scheduler::Clock::duration offset) {
+  return Scheduler::NextAligned(period, offset, Scheduler::Clock::now(),
+                                std::chrono::system_clock::now());
+}
+
+void Scheduler::SchedulePeriodic(std::string name,
+                                 Clock::duration initial_delay,
+                                 Clock::duration period, Task task) {
+  Add(std::unique_ptr<Entry>(new Entry{std::move(name), period,
+                                       std::move(task), false, false,
+                                       Clock::duration::zero()}),
+      Clock::now() + initial_delay);
+}
+
+void Scheduler::ScheduleAligned(std::string name, Clock::duration offset,
+                                Clock::duration period, Task task) {
+  offset %= period;
+  Add(std::unique_ptr<Entry>(new Entry{std::move(name), period,
+                                       std::move(task), false, true, offset}),
+      NextAlignedFromNow(period, offset));
+}
+
+void Scheduler::Add(std::unique_ptr<Entry> entry, Clock::time_point due) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  timers_.push(Timer{due, entry.get()});
+  entries_.push_back(std::move(entry));
+  timers_cv_.notify_one();
+}
+
+void Scheduler::Stop() noexcept {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  timers_cv_.notify_all();
+  ready_cv_.notify_all();
+  timer_thread_.join();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+void Scheduler::RunTimers() noexcept {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    if (timers_.empty()) {
+      timers_cv_.wait(lock);
+      continue;
+    }
+    auto timer = timers_.top();
+    auto now = Clock::now();
+    if (now < timer.due) {
+      timers_cv_.wait_until(lock, timer.due);
+      continue;
+    }
+
+    timers_.pop();
+    auto entry = timer.entry;
+    if (entry->running) {
+      Logger()->warn("Skipping run of {}: the previous one is still running",
+                     entry->name);
+    } else {
+      entry->running = true;
+      ready_.push_back(timer);
+      ready_cv_.notify_one();
+    }
+
+    // fixed rate: the next run is based on when this one was due, not on
+    // when it ran, skipping any ticks that have already passed
+    Clock::time_point next;
+    if (entry->aligned) {
+      // go back to the wall clock so we never drift from the step boundaries
+      next = NextAlignedFromNow(entry->period, entry->offset);
+      if (next < timer.due + entry->period / 2) {
+        next += entry->period;
+      }
+    } else {
+      next = timer.due + entry->period;
+      if (next <= now) {
+        next += (now - next) / entry->period * entry->period + entry->period;
+      }
+    }
+    timers_.push(Timer{next, entry});
+  }
+}
+
+void Scheduler::RunWorker() noexcept {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_cv_.wait(lock, [this] { return !running_ || !ready_.empty(); });
+    if (!running_) {
+      return;
+    }
+    auto timer = ready_.front();
+    ready_.pop_front();
+    lock.unlock();
+
+    auto entry = timer.entry;
+    if (lag_observer_) {
+      lag_observer_(entry->name, Clock::now() - timer.due);
+    }
+    try {
+      entry->task();
+    } catch (const std::exception& e) {
+      Logger()->error("Error running {}: {}", entry->name, e.what());
+    }
+
+    lock.lock();
+    entry->running = false;
+  }
+}
+
+}  // namespace util
+}  // namespace atlas
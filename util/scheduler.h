@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace atlas {
+namespace util {
+
+/// Runs periodic tasks at a fixed rate. A single thread keeps track of when
+/// each task is due and hands it to a bounded pool of workers, so a slow task
+/// does not delay the others
+class Scheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+  /// Gets how late a task started compared to when it was due
+  using LagObserver =
+      std::function<void(const std::string& name, Clock::duration lag)>;
+
+  explicit Scheduler(size_t num_workers,
+                     LagObserver lag_observer = nullptr) noexcept;
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  void Start();
+
+  /// Run a task every period, the first time after the initial delay. Runs of
+  /// the same task never overlap: ticks that are due while the task is still
+  /// running are skipped. Can be called while the scheduler is running
+  void SchedulePeriodic(std::string name, Clock::duration initial_delay,
+                        Clock::duration period, Task task);
+
+  /// Run a task at every multiple of the period in wall clock time plus an
+  /// offset. For example, with a period of 60s and an offset of 5s the task
+  /// runs 5s after the start of every minute. Ticks that are due while the
+  /// task is still running are skipped
+  void ScheduleAligned(std::string name, Clock::duration offset,
+                       Clock::duration period, Task task);
+
+  /// Stop running tasks, wait for the ones in progress and join all threads.
+  /// Must not be called from a task
+  void Stop() noexcept;
+
+  /// when the next run of an aligned task is due, given the current time on
+  /// the scheduler clock and on the wall clock
+  static Clock::time_point NextAligned(
+      Clock::duration period, Clock::duration offset, Clock::time_point now,
+      std::chrono::system_clock::time_point wall_now) noexcept;
+
+ private:
+  struct Entry {
+    std::string name;
+    Clock::duration period;
+    Task task;
+    bool running;
+    // whether to align runs to the wall clock, and the offset from the step
+    // boundary
+    bool aligned;
+    Clock::duration offset;
+  };
+
+  struct Timer {
+    Clock::time_point due;
+    Entry* entry;
+    bool operator>(const Timer& other) const noexcept {
+      return due > other.due;
+    }
+  };
+
+  const size_t num_workers_;
+  const LagObserver lag_observer_;
+
+  std::mutex mutex_;
+  std::condition_variable timers_cv_;
+  std::condition_variable ready_cv_;
+  bool running_{false};
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+  std::deque<Timer> ready_;
+
+  std::thread timer_thread_;
+  std::vector<std::thread> workers_;
+
+  void Add(std::unique_ptr<Entry> entry, Clock::time_point due);
+  void RunTimers() noexcept;
+  void RunWorker() noexcept;
+};
+
+}  // namespace util
+}  // namespace atlas
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+namespace atlas {
+namespace util {
+
+/// A vector of trivially copyable values that keeps up to N of them inline,
+/// and only goes to the heap when it grows beyond that
+template <typename T, size_t N>
+class SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SmallVector elements are copied with memcpy");
+
+ public:
+  SmallVector() noexcept = default;
+
+  SmallVector(const SmallVector& other) noexcept { assign(other); }
+
+  SmallVector(SmallVector&& other) noexcept { take(&other); }
+
+  SmallVector& operator=(const SmallVector& other) noexcept {
+    if (this != &other) {
+      size_ = 0;
+      assign(other);
+    }
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& other) noexcept {
+    if (this != &other) {
+      reset();
+      take(&other);
+    }
+    return *this;
+  }
+
+  ~SmallVector() { reset(); }
+
+  const T* begin() const noexcept { return data_; }
+  const T* end() const noexcept { return data_ + size_; }
+  T* begin() noexcept { return data_; }
+  T* end() noexcept { return data_ + size_; }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  const T& operator[](size_t i) const noexcept { return data_[i]; }
+  T& operator[](size_t i) noexcept { return data_[i]; }
+
+  void reserve(size_t capacity) noexcept {
+    if (capacity <= capacity_) {
+      return;
+    }
+    auto data = static_cast<T*>(malloc(capacity * sizeof(T)));
+    if (data == nullptr) {
+      abort();
+    }
+    memcpy(data, data_, size_ * sizeof(T));
+    if (data_ != inline_data()) {
+      free(data_);
+    }
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  /// insert a value before pos, returning where it was placed
+  T* insert(const T* pos, const T& value) noexcept {
+    auto i = static_cast<size_t>(pos - data_);
+    if (size_ == capacity_) {
+      reserve(capacity_ * 2);
+    }
+    memmove(data_ + i + 1, data_ + i, (size_ - i) * sizeof(T));
+    data_[i] = value;
+    ++size_;
+    return data_ + i;
+  }
+
+  void push_back(const T& value) noexcept { insert(end(), value); }
+
+  void clear() noexcept { size_ = 0; }
+
+ private:
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type inline_[N];
+  T* data_ = inline_data();
+  size_t size_ = 0;
+  size_t capacity_ = N;
+
+  T* inline_data() noexcept { return reinterpret_cast<T*>(inline_); }
+
+  void assign(const SmallVector& other) noexcept {
+    reserve(other.size_);
+    memcpy(data_, other.data_, other.size_ * sizeof(T));
+    size_ = other.size_;
+  }
+
+  void reset() noexcept {
+    if (data_ != inline_data()) {
+      free(data_);
+      data_ = inline_data();
+      capacity_ = N;
+    }
+    size_ = 0;
+  }
+
+  // steal the heap storage of other, or copy its inline values
+  void take(SmallVector* other) noexcept {
+    if (other->data_ == other->inline_data()) {
+      assign(*other);
+    } else {
+      data_ = other->data_;
+      size_ = other->size_;
+      capacity_ = other->capacity_;
+      other->data_ = other->inline_data();
+      other->capacity_ = N;
+    }
+    other->size_ = 0;
+  }
+};
+
+}  // namespace util
+}  // namespace atlas
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace atlas {
+namespace util {
+
+/// Holds the current version of a value that is read much more often than it
+/// changes. Readers never lock: they announce themselves in one of two
+/// counters and read the current pointer. Writers publish a new version and
+/// wait for a grace period, until every reader that could have seen the old
+/// one is done, before deleting it. Writers must be serialized by the caller
+template <typename T>
+class Snapshot {
+ public:
+  explicit Snapshot(std::unique_ptr<const T> initial) noexcept
+      : current_(initial.release()) {
+    readers_[0].store(0);
+    readers_[1].store(0);
+  }
+
+  ~Snapshot() { delete current_.load(); }
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  /// Call fn with the current version. It is only valid during the call, and
+  /// fn must not call Update
+  template <typename F>
+  auto Read(F&& fn) const -> decltype(fn(std::declval<const T&>())) {
+    auto& readers = readers_[epoch_.load() & 1];
+    readers.fetch_add(1);
+    Reader guard{&readers};
+    // loaded after announcing ourselves, so a writer waiting for the
+    // counter to drain knows we either see the new version or are counted
+    return fn(*current_.load());
+  }
+
+  /// the current version, for the writer
+  const T& Current() const noexcept { return *current_.load(); }
+
+  /// publish a new version and delete the previous one once no reader can
+  /// be using it
+  void Update(std::unique_ptr<const T> value) noexcept {
+    auto previous = current_.exchange(value.release());
+    // readers that started before the exchange hold the counter of the
+    // epoch they saw. Flipping twice and draining each counter waits for
+    // all of them, without being held up by readers that start later
+    for (auto phase = 0; phase < 2; ++phase) {
+      auto epoch = epoch_.fetch_add(1);
+      while (readers_[epoch & 1].load() != 0) {
+        std::this_thread::yield();
+      }
+    }
+    delete previous;
+  }
+
+ private:
+  struct Reader {
+    std::atomic<int64_t>* readers;
+    ~Reader() { readers->fetch_sub(1); }
+  };
+
+  std::atomic<const T*> current_;
+  mutable std::atomic<uint64_t> epoch_{0};
+  mutable std::atomic<int64_t> readers_[2];
+};
+
+}  // namespace util
+}  // namespace atlas
@@ -0,0 +1,208 @@
+#include "spill_ring.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace atlas {
+namespace util {
+
+static constexpr char kMagic[8] = {'A', 'T', 'L', 'S', 'P', 'I', 'L', '1'};
+static constexpr size_t kDataOffset = 64;
+static constexpr size_t kLenSize = sizeof(uint32_t);
+// marks the end of the data before the ring wraps around
+static constexpr uint32_t kWrapMarker = 0xFFFFFFFF;
+
+// Records are stored as a 32-bit length followed by the data, between head
+// and tail. When a record does not fit before the end of the file it goes at
+// the start, and the space left is counted as used until head gets there.
+struct SpillRing::Header {
+  char magic[8];
+  uint64_t capacity;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t used;
+  uint64_t count;
+  uint64_t first_seq;
+};
+
+std::unique_ptr<SpillRing> SpillRing::Open(const std::string& file_name,
+                                           size_t capacity) noexcept {
+  static_assert(sizeof(Header) <= kDataOffset,
+                "header must fit before the data");
+  auto logger = Logger();
+  auto fd = open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    logger->error("Unable to open spill file {}: {}", file_name,
+                  strerror(errno));
+    return nullptr;
+  }
+  auto map_size = kDataOffset + capacity;
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (static_cast<size_t>(st.st_size) != map_size &&
+       ftruncate(fd, static_cast<off_t>(map_size)) != 0)) {
+    logger->error("Unable to size spill file {}: {}", file_name,
+                  strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+  auto map =
+      mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    logger->error("Unable to map spill file {}: {}", file_name,
+                  strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+
+  std::unique_ptr<SpillRing> ring{
+      new SpillRing(fd, static_cast<char*>(map), map_size)};
+  if (!ring->Valid()) {
+    memcpy(ring->header_->magic, kMagic, sizeof kMagic);
+    ring->header_->capacity = capacity;
+    ring->header_->count = 0;
+    ring->header_->first_seq = 0;
+    ring->Clear();
+  } else if (ring->size() > 0) {
+    logger->info("Found {} records in spill file {}", ring->size(),
+                 file_name);
+  }
+  return ring;
+}
+
+SpillRing::SpillRing(int fd, char* map, size_t map_size) noexcept
+    : fd_(fd),
+      map_(map),
+      map_size_(map_size),
+      header_(reinterpret_cast<Header*>(map)),
+      data_(map + kDataOffset) {}
+
+SpillRing::~SpillRing() {
+  munmap(map_, map_size_);
+  close(fd_);
+}
+
+bool SpillRing::Valid() const noexcept {
+  const auto& h = *header_;
+  auto capacity = map_size_ - kDataOffset;
+  return memcmp(h.magic, kMagic, sizeof kMagic) == 0 &&
+         h.capacity == capacity && h.head < capacity && h.tail < capacity &&
+         h.used <= capacity && (h.count > 0 || h.used == 0);
+}
+
+void SpillRing::Clear() noexcept {
+  header_->first_seq += header_->count;
+  header_->head = 0;
+  header_->tail = 0;
+  header_->used = 0;
+  header_->count = 0;
+}
+
+bool SpillRing::Fits(size_t size) const noexcept {
+  return size < kWrapMarker && kLenSize + size <= header_->capacity;
+}
+
+bool SpillRing::HasRoom(size_t size) const noexcept {
+  if (!Fits(size)) {
+    return false;
+  }
+  const auto& h = *header_;
+  auto needed = kLenSize + size;
+  if (h.count == 0) {
+    return true;
+  }
+  auto wasted = h.tail + needed > h.capacity ? h.capacity - h.tail : 0;
+  return h.capacity - h.used >= wasted + needed;
+}
+
+bool SpillRing::Push(const char* data, size_t size) noexcept {
+  if (!HasRoom(size)) {
+    return false;
+  }
+  auto& h = *header_;
+  if (h.count == 0) {
+    Clear();
+  }
+  auto needed = kLenSize + size;
+  if (h.tail + needed > h.capacity) {
+    auto wasted = h.capacity - h.tail;
+    if (wasted >= kLenSize) {
+      memcpy(data_ + h.tail, &kWrapMarker, kLenSize);
+    }
+    h.used += wasted;
+    h.tail = 0;
+  }
+  auto len = static_cast<uint32_t>(size);
+  memcpy(data_ + h.tail, &len, kLenSize);
+  memcpy(data_ + h.tail + kLenSize, data, size);
+  h.tail += needed;
+  if (h.tail == h.capacity) {
+    h.tail = 0;
+  }
+  h.used += needed;
+  ++h.count;
+  return true;
+}
+
+void SpillRing::SkipGap() noexcept {
+  auto& h = *header_;
+  uint32_t len = kWrapMarker;
+  if (h.capacity - h.head >= kLenSize) {
+    memcpy(&len, data_ + h.head, kLenSize);
+  }
+  if (len == kWrapMarker) {
+    h.used -= h.capacity - h.head;
+    h.head = 0;
+  }
+}
+
+bool SpillRing::Front(std::string* record, uint64_t* seq, size_t max_size) {
+  const auto& h = *header_;
+  if (h.count == 0) {
+    return false;
+  }
+  uint32_t len;
+  memcpy(&len, data_ + h.head, kLenSize);
+  if (h.head + kLenSize + len > h.capacity || kLenSize + len > h.used) {
+    // not something we wrote, so start over
+    Logger()->error("Dropping {} records from a corrupted spill file",
+                    h.count);
+    Clear();
+    return false;
+  }
+  record->assign(data_ + h.head + kLenSize, std::min<size_t>(len, max_size));
+  *seq = h.first_seq;
+  return true;
+}
+
+void SpillRing::Pop(uint64_t seq) noexcept {
+  auto& h = *header_;
+  if (h.count == 0 || seq != h.first_seq) {
+    return;
+  }
+  uint32_t len;
+  memcpy(&len, data_ + h.head, kLenSize);
+  h.head += kLenSize + len;
+  h.used -= kLenSize + len;
+  ++h.first_seq;
+  if (--h.count == 0) {
+    Clear();
+    return;
+  }
+  if (h.head == h.capacity) {
+    h.head = 0;
+  } else {
+    SkipGap();
+  }
+}
+
+size_t SpillRing::size() const noexcept { return header_->count; }
+
+size_t SpillRing::bytes() const noexcept { return header_->used; }
+
+}  // namespace util
+}  // namespace atlas
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace atlas {
+namespace util {
+
+/// A bounded FIFO of byte records kept in a memory mapped file, so records
+/// survive restarts. Records are stored back to back in a ring; callers make
+/// room for new records by popping old ones. Not thread safe
+class SpillRing {
+ public:
+  /// Open the ring stored in file_name, creating it if needed. An existing
+  /// file with a different capacity or that is not valid starts out empty.
+  /// Returns nullptr if the file cannot be mapped
+  static std::unique_ptr<SpillRing> Open(const std::string& file_name,
+                                         size_t capacity) noexcept;
+
+  ~SpillRing();
+  SpillRing(const SpillRing&) = delete;
+  SpillRing& operator=(const SpillRing&) = delete;
+
+  /// whether a record of the given size fits without popping any others
+  bool HasRoom(size_t size) const noexcept;
+
+  /// whether a record of the given size could ever fit
+  bool Fits(size_t size) const noexcept;
+
+  /// Append a record. Returns false if there is no room for it
+  bool Push(const char* data, size_t size) noexcept;
+
+  /// Copy the oldest record, or its first max_size bytes. seq identifies it
+  /// for Pop. Returns false if the ring is empty
+  bool Front(std::string* record, uint64_t* seq,
+             size_t max_size = SIZE_MAX);
+
+  /// Remove the oldest record, if it is still the one identified by seq
+  void Pop(uint64_t seq) noexcept;
+
+  size_t size() const noexcept;
+
+  /// bytes in use, including the space lost when records wrap around
+  size_t bytes() const noexcept;
+
+ private:
+  struct Header;
+  int fd_;
+  char* map_;
+  size_t map_size_;
+  Header* header_;
+  char* data_;
+
+  SpillRing(int fd, char* map, size_t map_size) noexcept;
+  void Clear() noexcept;
+  bool Valid() const noexcept;
+  void SkipGap() noexcept;
+};
+
+}  // namespace util
+}  // namespace atlas
@@ -1,4 +1,12 @@
 #include "string_pool.h"
+#include "xxhash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
 
 namespace atlas {
 namespace util {
@@ -8,25 +16,458 @@ StringPool& the_str_pool() {
   return *the_pool;
 }
 
-StringPool::~StringPool() noexcept {
-  for (const auto& kv : table) {
-    auto copy = static_cast<void*>(const_cast<char*>(kv.first));
-    free(copy);
+namespace {
+
+// the string might be referenced by code that does not keep track of it, so
+// it can never be reclaimed
+constexpr uint32_t kPinned = 1u << 31;
+// the string was reclaimed and can no longer be referenced
+constexpr uint32_t kDead = 1u << 30;
+
+struct Chunk {
+  // number of strings in the chunk that have not been reclaimed
+  size_t live;
+};
+
+// an interned string, followed in memory by its characters
+struct Node {
+  uint64_t hash;
+  size_t size;
+  Chunk* chunk;
+  // kPinned, kDead and the number of references
+  std::atomic<uint32_t> state;
+  // generation in which the string was last unreferenced
+  std::atomic<uint32_t> last_used;
+  // strings derived from this one, each holding a reference
+  std::atomic<Node*> memos[StringPool::kNumMemos];
+  StrRef ref;
+
+  const char* data() const noexcept {
+    return reinterpret_cast<const char*>(this + 1);
+  }
+};
+
+inline Node* node_for(StrRef ref) noexcept {
+  return reinterpret_cast<Node*>(const_cast<char*>(ref.get())) - 1;
+}
+
+// take a reference to the string, unless it is pinned. Fails if the string
+// has been reclaimed
+inline bool ref_node(Node* node) noexcept {
+  auto s = node->state.load(std::memory_order_relaxed);
+  do {
+    if ((s & kDead) != 0) {
+      return false;
+    }
+    if ((s & kPinned) != 0) {
+      return true;
+    }
+  } while (!node->state.compare_exchange_weak(s, s + 1));
+  return true;
+}
+
+inline void release_node(Node* node, uint32_t generation) noexcept {
+  auto s = node->state.load(std::memory_order_relaxed);
+  do {
+    // pinning is permanent, so if the string is pinned now it either was
+    // when the reference was taken, or the count no longer matters. A string
+    // that was reclaimed has no references left to give back
+    if ((s & (kPinned | kDead)) != 0 || s == 0) {
+      return;
+    }
+    if (s == 1) {
+      node->last_used.store(generation, std::memory_order_relaxed);
+    }
+  } while (!node->state.compare_exchange_weak(s, s - 1));
+}
+
+inline bool pin_node(Node* node) noexcept {
+  auto s = node->state.load(std::memory_order_relaxed);
+  do {
+    if ((s & kDead) != 0) {
+      return false;
+    }
+    if ((s & kPinned) != 0) {
+      return true;
+    }
+  } while (!node->state.compare_exchange_weak(s, s | kPinned));
+  return true;
+}
+
+// open addressing table of immutable nodes, so it can be read without locks
+struct Table {
+  explicit Table(size_t capacity)
+      : mask(capacity - 1), slots(new std::atomic<Node*>[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) {
+      slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  const size_t mask;
+  std::unique_ptr<std::atomic<Node*>[]> slots;
+};
+
+// bump allocator for nodes. A chunk can be freed once all the strings in it
+// have been reclaimed
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena() {
+    for (auto chunk : chunks_) {
+      free(chunk);
+    }
+  }
+
+  // allocate size bytes in *chunk. If the chunk that was being filled had
+  // nothing live left it is set in *retired, and the caller must free it
+  void* Allocate(size_t size, Chunk** chunk, Chunk** retired) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    *retired = nullptr;
+    if (size > available_) {
+      // big strings get their own chunk
+      if (size > kChunkSize / 4) {
+        *chunk = NewChunk(size);
+        (*chunk)->live = 1;
+        return *chunk + 1;
+      }
+      auto previous = current_;
+      current_ = NewChunk(kChunkSize);
+      next_ = reinterpret_cast<char*>(current_ + 1);
+      available_ = kChunkSize;
+      if (previous != nullptr && previous->live == 0) {
+        Remove(previous);
+        *retired = previous;
+      }
+    }
+    auto res = next_;
+    next_ += size;
+    available_ -= size;
+    ++current_->live;
+    *chunk = current_;
+    return res;
+  }
+
+  // a string in the given chunk was reclaimed. Returns the chunk if nothing
+  // in it is live anymore, in which case the caller must free it
+  Chunk* Reclaim(Chunk* chunk) noexcept {
+    if (--chunk->live > 0 || chunk == current_) {
+      return nullptr;
+    }
+    Remove(chunk);
+    return chunk;
+  }
+
+ private:
+  static constexpr size_t kChunkSize = 64 * 1024;
+  static constexpr size_t kAlignment = alignof(Node);
+  std::vector<Chunk*> chunks_;
+  Chunk* current_ = nullptr;
+  char* next_ = nullptr;
+  size_t available_ = 0;
+
+  Chunk* NewChunk(size_t size) {
+    auto chunk = static_cast<Chunk*>(malloc(sizeof(Chunk) + size));
+    if (chunk == nullptr) {
+      abort();
+    }
+    chunk->live = 0;
+    chunks_.push_back(chunk);
+    return chunk;
+  }
+
+  void Remove(Chunk* chunk) noexcept {
+    chunks_.erase(std::find(chunks_.begin(), chunks_.end(), chunk));
+  }
+};
+
+constexpr size_t kInitialCapacity = 256;
+}  // namespace
+
+class StringPool::Shard {
+ public:
+  Shard() : table_(new Table(kInitialCapacity)) {}
+
+  ~Shard() {
+    delete table_.load();
+    for (const auto& t : retired_tables_) {
+      delete t.second;
+    }
+    for (const auto& c : retired_chunks_) {
+      free(c.second);
+    }
+  }
+
+  Node* Find(const char* string, size_t size, uint64_t hash) const noexcept {
+    return Find(*table_.load(std::memory_order_acquire), string, size, hash);
+  }
+
+  Node* Insert(const char* string, size_t size, uint64_t hash, bool pin,
+               uint32_t generation) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    // someone might have added it since we looked. Strings can't be
+    // reclaimed while we hold the lock
+    auto table = table_.load(std::memory_order_relaxed);
+    auto node = Find(*table, string, size, hash);
+    if (node != nullptr) {
+      pin ? pin_node(node) : ref_node(node);
+      return node;
+    }
+
+    Chunk* chunk;
+    Chunk* retired;
+    node = new (arena_.Allocate(sizeof(Node) + size + 1, &chunk, &retired))
+        Node;
+    if (retired != nullptr) {
+      retired_chunks_.emplace_back(generation, retired);
+    }
+    auto data = reinterpret_cast<char*>(node + 1);
+    memcpy(data, string, size);
+    data[size] = '\0';
+    node->hash = hash;
+    node->size = size;
+    node->chunk = chunk;
+    node->state.store(pin ? kPinned : 1, std::memory_order_relaxed);
+    node->last_used.store(generation, std::memory_order_relaxed);
+    for (auto& memo : node->memos) {
+      memo.store(nullptr, std::memory_order_relaxed);
+    }
+    node->ref.data = data;
+
+    // keep the load factor under 1/2
+    if ((size_ + 1) * 2 > table->mask + 1) {
+      table = Rebuild(table, (table->mask + 1) * 2, generation);
+    }
+    Put(table, node);
+    size_.store(size_ + 1, std::memory_order_relaxed);
+    alloc_size_.store(alloc_size_ + size + 1, std::memory_order_relaxed);
+    return node;
+  }
+
+  size_t Sweep(uint32_t generation) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    FreeRetired(generation);
+
+    // reclaim the strings that have not been referenced since before the
+    // previous sweep
+    auto table = table_.load(std::memory_order_relaxed);
+    auto capacity = table->mask + 1;
+    std::vector<Node*> dead;
+    for (size_t i = 0; i < capacity; ++i) {
+      auto node = table->slots[i].load(std::memory_order_relaxed);
+      if (node == nullptr ||
+          node->last_used.load(std::memory_order_relaxed) + 1 >= generation) {
+        continue;
+      }
+      uint32_t unreferenced = 0;
+      if (node->state.compare_exchange_strong(unreferenced, kDead)) {
+        dead.push_back(node);
+      }
+    }
+    if (dead.empty()) {
+      return 0;
+    }
+
+    auto live = size_ - dead.size();
+    while (capacity > kInitialCapacity && live * 4 < capacity) {
+      capacity /= 2;
+    }
+    Rebuild(table, capacity, generation);
+    size_t freed = 0;
+    for (auto node : dead) {
+      for (auto& memo : node->memos) {
+        auto derived = memo.load(std::memory_order_acquire);
+        if (derived != nullptr && derived != node) {
+          release_node(derived, generation);
+        }
+      }
+      freed += node->size + 1;
+      auto chunk = arena_.Reclaim(node->chunk);
+      if (chunk != nullptr) {
+        retired_chunks_.emplace_back(generation, chunk);
+      }
+    }
+    size_.store(live, std::memory_order_relaxed);
+    alloc_size_.store(alloc_size_ - freed, std::memory_order_relaxed);
+    return dead.size();
+  }
+
+  size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  size_t alloc_size() const noexcept {
+    return alloc_size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<Table*> table_;
+  // tables and chunks that are no longer used but that readers might still
+  // be looking at, with the generation in which they were retired
+  std::vector<std::pair<uint32_t, Table*>> retired_tables_;
+  std::vector<std::pair<uint32_t, Chunk*>> retired_chunks_;
+  std::mutex mutex_;
+  Arena arena_;
+  std::atomic<size_t> size_{0};
+  std::atomic<size_t> alloc_size_{0};
+
+  static Node* Find(const Table& table, const char* string, size_t size,
+                    uint64_t hash) noexcept {
+    for (auto i = hash & table.mask;; i = (i + 1) & table.mask) {
+      auto node = table.slots[i].load(std::memory_order_acquire);
+      if (node == nullptr) {
+        return nullptr;
+      }
+      if (node->hash == hash && node->size == size &&
+          memcmp(node->data(), string, size) == 0) {
+        return node;
+      }
+    }
+  }
+
+  static void Put(Table* table, Node* node) noexcept {
+    auto i = node->hash & table->mask;
+    while (table->slots[i].load(std::memory_order_relaxed) != nullptr) {
+      i = (i + 1) & table->mask;
+    }
+    table->slots[i].store(node, std::memory_order_release);
   }
+
+  // replace the table with one of the given capacity without the strings
+  // that have been reclaimed
+  Table* Rebuild(Table* table, size_t capacity, uint32_t generation) {
+    auto rebuilt = new Table(capacity);
+    for (size_t i = 0; i <= table->mask; ++i) {
+      auto node = table->slots[i].load(std::memory_order_relaxed);
+      if (node != nullptr &&
+          (node->state.load(std::memory_order_relaxed) & kDead) == 0) {
+        Put(rebuilt, node);
+      }
+    }
+    table_.store(rebuilt, std::memory_order_release);
+    retired_tables_.emplace_back(generation, table);
+    return rebuilt;
+  }
+
+  // free what was retired at least a full sweep interval ago
+  void FreeRetired(uint32_t generation) {
+    auto t = retired_tables_.begin();
+    for (; t != retired_tables_.end() && t->first + 2 <= generation; ++t) {
+      delete t->second;
+    }
+    retired_tables_.erase(retired_tables_.begin(), t);
+
+    auto c = retired_chunks_.begin();
+    for (; c != retired_chunks_.end() && c->first + 2 <= generation; ++c) {
+      free(c->second);
+    }
+    retired_chunks_.erase(retired_chunks_.begin(), c);
+  }
+};
+
+StringPool::StringPool() noexcept : shards_(new Shard[kNumShards]) {}
+
+StringPool::~StringPool() noexcept = default;
+
+StringPool::Shard& StringPool::shard_for(uint64_t hash) const noexcept {
+  // the low bits pick the slot within the shard
+  return shards_[(hash >> 32) % kNumShards];
 }
 
 const StrRef& StringPool::intern(const char* string) noexcept {
-  std::lock_guard<std::mutex> guard(mutex);
-  auto it = table.find(string);
-  if (it != table.end()) {
-    return it->second;
+  return intern(string, strlen(string));
+}
+
+const StrRef& StringPool::intern(const char* string, size_t size) noexcept {
+  auto hash = XXH64(string, size, 42);
+  auto& shard = shard_for(hash);
+  auto node = shard.Find(string, size, hash);
+  if (node == nullptr || !pin_node(node)) {
+    node = shard.Insert(string, size, hash, true, generation());
   }
-  const auto* copy = strdup(string);
-  StrRef ref;
-  ref.data = copy;
-  table.insert(std::make_pair(copy, ref));
-  alloc_size_ += strlen(copy) + 1;  // null terminator
-  return table.at(copy);
+  return node->ref;
+}
+
+StrRef StringPool::acquire(const char* string) noexcept {
+  return acquire(string, strlen(string));
+}
+
+StrRef StringPool::acquire(const char* string, size_t size) noexcept {
+  auto hash = XXH64(string, size, 42);
+  auto& shard = shard_for(hash);
+  auto node = shard.Find(string, size, hash);
+  if (node == nullptr || !ref_node(node)) {
+    node = shard.Insert(string, size, hash, false, generation());
+  }
+  return node->ref;
+}
+
+StrRef StringPool::acquire(StrRef ref) noexcept {
+  if (ref.get() == nullptr) {
+    return ref;
+  }
+  auto node = node_for(ref);
+  if (ref_node(node)) {
+    return ref;
+  }
+  // reclaimed, but its memory is kept for the grace period
+  return acquire(node->data(), node->size);
+}
+
+void StringPool::release(StrRef ref) noexcept {
+  if (ref.get() != nullptr) {
+    release_node(node_for(ref), generation());
+  }
+}
+
+StrRef StringPool::memo(StrRef ref, size_t slot) const noexcept {
+  auto derived = node_for(ref)->memos[slot].load(std::memory_order_acquire);
+  return derived != nullptr ? derived->ref : StrRef();
+}
+
+StrRef StringPool::set_memo(StrRef ref, size_t slot, StrRef value) noexcept {
+  // a string does not hold a reference to itself, or it could never be
+  // reclaimed
+  auto self = value == ref;
+  if (!self) {
+    value = acquire(value);
+  }
+  auto derived = node_for(value);
+  Node* existing = nullptr;
+  if (node_for(ref)->memos[slot].compare_exchange_strong(existing, derived)) {
+    return value;
+  }
+  if (!self) {
+    release(value);
+  }
+  return existing->ref;
+}
+
+size_t StringPool::Sweep() noexcept {
+  auto generation = generation_.fetch_add(1) + 1;
+  size_t reclaimed = 0;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    reclaimed += shards_[i].Sweep(generation);
+  }
+  return reclaimed;
+}
+
+size_t StringPool::pool_size() const noexcept {
+  size_t total = 0;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    total += shards_[i].size();
+  }
+  return total;
+}
+
+size_t StringPool::alloc_size() const noexcept {
+  size_t total = 0;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    total += shards_[i].alloc_size();
+  }
+  return total;
 }
 
 }  // namespace util
@@ -1,45 +1,85 @@
 #pragma once
 
 #include "intern.h"
-#include "xxhash.h"
-#include <cstdlib>
-#include <cstring>
-#include <mutex>
-#include <unordered_map>
+#include <atomic>
+#include <memory>
 
 namespace atlas {
 namespace util {
 
-struct CStrHasher {
-  size_t operator()(const char* str) const {
-    return XXH64(str, std::strlen(str), 42);
-  }
-};
-
-struct CStrComparer {
-  bool operator()(const char* s1, const char* s2) const {
-    return std::strcmp(s1, s2) == 0;
-  }
-};
-
+/// A concurrent string interning table. The table is split in shards: lookups
+/// of strings that are already interned never lock, and adding new strings
+/// only locks the shard they belong to. Interned strings are stored in arenas
+/// owned by their shard.
+///
+/// Strings returned by intern live as long as the pool. Strings that are only
+/// ever obtained through acquire are reference counted instead, and Sweep
+/// reclaims them once they have gone unreferenced for a full sweep interval.
+///
+/// Only owners that keep strings for longer than a sweep interval take
+/// references. Everything else copies refs without counting them, and relies
+/// on the grace period: a string that is released stays valid, and can be
+/// acquired again through its ref, until the sweep after the next one. Once
+/// reclaimed its memory is kept for two more sweeps, during which acquiring
+/// the ref interns the string again. Holding an uncounted ref for longer
+/// than that is a bug.
 class StringPool {
  public:
-  StringPool() noexcept {}
+  StringPool() noexcept;
   ~StringPool() noexcept;
   StringPool(const StringPool& pool) = delete;
   StringPool& operator=(const StringPool& pool) = delete;
 
   const StrRef& intern(const char* string) noexcept;
 
-  size_t pool_size() const noexcept { return table.size(); }
+  /// intern a string that is not null terminated
+  const StrRef& intern(const char* string, size_t size) noexcept;
+
+  /// intern a string and take a reference to it, which must be given back
+  /// with release
+  StrRef acquire(const char* string) noexcept;
+  StrRef acquire(const char* string, size_t size) noexcept;
+
+  /// Take a reference to the string a ref points to. Returns the ref the
+  /// reference was taken on, which is a new one if the string had already
+  /// been reclaimed
+  StrRef acquire(StrRef ref) noexcept;
 
-  size_t alloc_size() const noexcept { return alloc_size_; }
+  void release(StrRef ref) noexcept;
+
+  static constexpr size_t kNumMemos = 2;
+
+  /// Get the string remembered in the given slot for an interned string, or
+  /// a null ref. Memos are meant for strings derived from another one, like
+  /// a sanitized copy, and live at least as long as the string they were
+  /// derived from. A string can be its own memo, for instance when it did
+  /// not need any changes. Never locks
+  StrRef memo(StrRef ref, size_t slot) const noexcept;
+
+  /// Remember value in the given slot for ref, unless one was already set.
+  /// Returns the memo that was kept
+  StrRef set_memo(StrRef ref, size_t slot, StrRef value) noexcept;
+
+  /// reclaim strings that have not been referenced since before the previous
+  /// sweep. Meant to be called periodically. Returns the number of strings
+  /// reclaimed
+  size_t Sweep() noexcept;
+
+  size_t pool_size() const noexcept;
+
+  size_t alloc_size() const noexcept;
 
  private:
-  std::unordered_map<const char*, StrRef, CStrHasher, CStrComparer> table;
-  size_t alloc_size_ = 0;
+  class Shard;
+  static constexpr size_t kNumShards = 32;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<uint32_t> generation_{1};
 
-  std::mutex mutex;
+  Shard& shard_for(uint64_t hash) const noexcept;
+
+  uint32_t generation() const noexcept {
+    return generation_.load(std::memory_order_relaxed);
+  }
 };
 
 StringPool& the_str_pool();
@@ -1,6 +1,7 @@
 #include "strings.h"
 #include "environment.h"
 #include "logger.h"
+#include "string_pool.h"
 #include <sstream>
 
 #include <pcre.h>
@@ -76,22 +77,50 @@ std::string ExpandEnvVars(const std::string& raw) noexcept {
   return ExpandVars(raw, expander);
 }
 
-static StrRef ToValidTable(const std::array<bool, 128>& table,
+// slots in the string pool where the sanitized version of a string is kept
+static constexpr size_t kCharsMemo = 0;
+static constexpr size_t kGroupCharsMemo = 1;
+
+static inline bool is_valid_char(const std::array<bool, 128>& table,
+                                 char ch) noexcept {
+  auto c = static_cast<unsigned char>(ch);
+  return c < table.size() && table[c];
+}
+
+static StrRef ToValidTable(const std::array<bool, 128>& table, size_t memo,
                            StrRef atlas_str_ref) noexcept {
-  std::string ret;
-  std::string atlas_str = atlas_str_ref.get();
-  ret.resize(atlas_str.size());
-  const auto n = atlas_str.length();
-  for (size_t i = 0; i < n; ++i) {
-    auto ch = atlas_str[i];
-    auto valid = (static_cast<size_t>(ch) >= table.size()) ? false : table[ch];
-    ret[i] = valid ? ch : '_';
+  // strings we have seen before remember their sanitized version, which is
+  // the string itself if it was already valid
+  auto& pool = the_str_pool();
+  auto sanitized = pool.memo(atlas_str_ref, memo);
+  if (sanitized.get() != nullptr) {
+    return sanitized;
+  }
+
+  // most strings are already valid, so check that first without copying
+  const char* atlas_str = atlas_str_ref.get();
+  auto p = atlas_str;
+  while (*p != '\0' && is_valid_char(table, *p)) {
+    ++p;
+  }
+  if (*p == '\0') {
+    return pool.set_memo(atlas_str_ref, memo, atlas_str_ref);
+  }
+
+  std::string ret{atlas_str};
+  for (auto i = static_cast<size_t>(p - atlas_str); i < ret.size(); ++i) {
+    if (!is_valid_char(table, ret[i])) {
+      ret[i] = '_';
+    }
   }
-  return intern_str(ret);
+  auto ref = pool.acquire(ret.c_str(), ret.size());
+  sanitized = pool.set_memo(atlas_str_ref, memo, ref);
+  pool.release(ref);
+  return sanitized;
 }
 
 StrRef ToValidCharset(StrRef atlas_str_ref) noexcept {
-  return ToValidTable(kCharsAllowed, atlas_str_ref);
+  return ToValidTable(kCharsAllowed, kCharsMemo, atlas_str_ref);
 }
 
 std::string join_path(const std::string& dir, const char* file_name) noexcept {
@@ -113,8 +142,8 @@ auto kClusterRef = intern_str("nf.cluster");
 
 StrRef EncodeValueForKey(StrRef value, StrRef key) noexcept {
   auto isGroup = kAsgRef == key || kClusterRef == key;
-  const auto& table = isGroup ? kGroupCharsAllowed : kCharsAllowed;
-  return ToValidTable(table, value);
+  return isGroup ? ToValidTable(kGroupCharsAllowed, kGroupCharsMemo, value)
+                 : ToValidTable(kCharsAllowed, kCharsMemo, value);
 }
 
 bool IStartsWith(const std::string& s, const std::string& prefix) noexcept {
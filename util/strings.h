@@ -36,11 +36,16 @@ std::string ExpandEnvVars(const std::string& raw) noexcept;
 /// get the sanitized string representation of atlas_str
 /// letters, numbers, dots, and underscores are allowed, otherwise we convert it
 /// to _
+///
+/// The result is either atlas_str_ref itself or a memo of it, and no
+/// reference is taken for the caller: it is only valid while atlas_str_ref
+/// is. Use acquire_ref to keep it longer
 StrRef ToValidCharset(StrRef atlas_str_ref) noexcept;
 
 /// convert value to a representation atlas would allow
 /// some keys have a more relaxed restriction, therefore this
-/// function needs to know for which key we need to encode
+/// function needs to know for which key we need to encode. Like
+/// ToValidCharset, the result is only valid while value is
 StrRef EncodeValueForKey(StrRef value, StrRef key) noexcept;
 
 std::string join_path(const std::string& dir, const char* file_name) noexcept;